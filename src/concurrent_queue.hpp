@@ -0,0 +1,244 @@
+#ifndef SJTU_CONCURRENT_QUEUE_HPP
+#define SJTU_CONCURRENT_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <new> // placement new
+#include <utility> // std::move
+
+#define PTL_CACHE_LINE_SIZE 64
+
+/**
+ * 线程间传递数据的有界队列, 容量在构造时给定并向上取整为 2 的幂
+ * 接口沿用 deque 的 push_back / pop_front / size, 但队列满或空时不抛出异常, 而是返回 false (批量版本返回实际个数)
+ *   spsc_queue: 单生产者单消费者, 无等待 (wait-free)
+ *   mpmc_queue: 多生产者多消费者, 无锁 (lock-free), 每个槽位带序号 (Vyukov 有界队列)
+ * size() 在有并发修改时只是一个近似值
+ */
+
+namespace sjtu {
+
+    namespace concurrent_detail {
+        inline size_t roundCapacity(size_t capacity) {
+            if (capacity < 2) capacity = 2;
+            size_t result = 1;
+            while (result < capacity) result <<= 1;
+            return result;
+        }
+
+        // 独占一个缓存行的计数器, 避免生产者与消费者的下标互相伪共享
+        struct alignas(PTL_CACHE_LINE_SIZE) PaddedIndex {
+            std::atomic<size_t> value{0};
+        };
+    }
+
+    template<class T>
+    class spsc_queue {
+    private:
+        std::pmr::memory_resource *memResource;
+        size_t memorySize, mask;
+        T *elementData;
+
+        concurrent_detail::PaddedIndex headIndex; // 仅消费者写
+        concurrent_detail::PaddedIndex tailIndex; // 仅生产者写
+        // 各自缓存对方的下标, 只有看起来满/空时才重新读取对方的缓存行
+        alignas(PTL_CACHE_LINE_SIZE) size_t cachedHead;
+        alignas(PTL_CACHE_LINE_SIZE) size_t cachedTail;
+
+    public:
+        explicit spsc_queue(size_t capacity, std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : memResource(res), memorySize(concurrent_detail::roundCapacity(capacity)), mask(memorySize - 1),
+                  cachedHead(0), cachedTail(0) {
+            elementData = static_cast<T *>(memResource->allocate(sizeof(T) * memorySize, alignof(T)));
+        }
+
+        spsc_queue(const spsc_queue &other) = delete;
+
+        spsc_queue &operator=(const spsc_queue &other) = delete;
+
+        ~spsc_queue() {
+            size_t head = headIndex.value.load(std::memory_order_relaxed);
+            size_t tail = tailIndex.value.load(std::memory_order_relaxed);
+            for (; head != tail; ++head) elementData[head & mask].~T();
+            memResource->deallocate(elementData, sizeof(T) * memorySize, alignof(T));
+        }
+
+        // 仅生产者调用
+        bool push_back(const T &value) {
+            size_t tail = tailIndex.value.load(std::memory_order_relaxed);
+            if (tail - cachedHead == memorySize) {
+                cachedHead = headIndex.value.load(std::memory_order_acquire);
+                if (tail - cachedHead == memorySize) return false;
+            }
+            ::new(static_cast<void *>(elementData + (tail & mask))) T(value);
+            tailIndex.value.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 批量入队 [first, first + n) 的前缀, 返回入队个数, 只发布一次下标
+        size_t push_back(const T *first, size_t n) {
+            size_t tail = tailIndex.value.load(std::memory_order_relaxed);
+            if (memorySize - (tail - cachedHead) < n)
+                cachedHead = headIndex.value.load(std::memory_order_acquire);
+            size_t freeNum = memorySize - (tail - cachedHead);
+            if (n > freeNum) n = freeNum;
+            for (size_t i = 0; i < n; ++i)
+                ::new(static_cast<void *>(elementData + ((tail + i) & mask))) T(first[i]);
+            if (n > 0) tailIndex.value.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // 仅消费者调用
+        bool pop_front(T &out) {
+            size_t head = headIndex.value.load(std::memory_order_relaxed);
+            if (head == cachedTail) {
+                cachedTail = tailIndex.value.load(std::memory_order_acquire);
+                if (head == cachedTail) return false;
+            }
+            T &slot = elementData[head & mask];
+            out = std::move(slot);
+            slot.~T();
+            headIndex.value.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 批量出队至多 n 个元素到 out, 返回出队个数
+        size_t pop_front(T *out, size_t n) {
+            size_t head = headIndex.value.load(std::memory_order_relaxed);
+            if (cachedTail - head < n) cachedTail = tailIndex.value.load(std::memory_order_acquire);
+            size_t readyNum = cachedTail - head;
+            if (n > readyNum) n = readyNum;
+            for (size_t i = 0; i < n; ++i) {
+                T &slot = elementData[(head + i) & mask];
+                out[i] = std::move(slot);
+                slot.~T();
+            }
+            if (n > 0) headIndex.value.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        size_t size() const {
+            size_t tail = tailIndex.value.load(std::memory_order_acquire);
+            return tail - headIndex.value.load(std::memory_order_acquire);
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return memorySize; }
+    };
+
+    template<class T>
+    class mpmc_queue {
+    private:
+        /**
+         * 槽位 i 的 sequence:
+         *   == pos     时可供位置 pos 的生产者写入
+         *   == pos + 1 时已写入, 可供位置 pos 的消费者读取
+         * 读取后置为 pos + 容量, 即下一轮的可写状态
+         */
+        struct Cell {
+            std::atomic<size_t> sequence;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            T *element() { return reinterpret_cast<T *>(storage); }
+        };
+
+        std::pmr::memory_resource *memResource;
+        size_t memorySize, mask;
+        Cell *cellData;
+
+        concurrent_detail::PaddedIndex enqueueIndex;
+        concurrent_detail::PaddedIndex dequeueIndex;
+
+        /**
+         * 从 pos 起数出至多 n 个连续的状态为 pos + i + offset 的槽位 (offset = 0 可写, 1 可读)
+         * 这些槽位在本线程通过 CAS 取得之前不会被其他线程改变状态
+         */
+        size_t countReady(size_t pos, size_t n, size_t offset) const {
+            size_t i = 0;
+            while (i < n && cellData[(pos + i) & mask].sequence.load(std::memory_order_acquire) == pos + i + offset) ++i;
+            return i;
+        }
+
+        // 取得 [pos, pos + k) 共至多 n 个槽位的所有权, k == 0 表示队列满 (空)
+        size_t claim(concurrent_detail::PaddedIndex &index, size_t n, size_t offset, size_t &pos) {
+            pos = index.value.load(std::memory_order_relaxed);
+            while (true) {
+                size_t k = countReady(pos, n, offset);
+                if (k == 0) {
+                    // 槽位序号落后于 pos 说明上一轮尚未完成, 即队列满 (空); 超前则是 pos 已被其他线程取走
+                    size_t seq = cellData[pos & mask].sequence.load(std::memory_order_acquire);
+                    if (std::ptrdiff_t(seq - pos - offset) < 0) return 0;
+                    pos = index.value.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (index.value.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) return k;
+            }
+        }
+
+    public:
+        explicit mpmc_queue(size_t capacity, std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : memResource(res), memorySize(concurrent_detail::roundCapacity(capacity)), mask(memorySize - 1) {
+            cellData = static_cast<Cell *>(memResource->allocate(sizeof(Cell) * memorySize, alignof(Cell)));
+            for (size_t i = 0; i < memorySize; ++i)
+                ::new(static_cast<void *>(cellData + i)) Cell{{i}, {}};
+        }
+
+        mpmc_queue(const mpmc_queue &other) = delete;
+
+        mpmc_queue &operator=(const mpmc_queue &other) = delete;
+
+        ~mpmc_queue() {
+            size_t head = dequeueIndex.value.load(std::memory_order_relaxed);
+            size_t tail = enqueueIndex.value.load(std::memory_order_relaxed);
+            for (; head != tail; ++head) cellData[head & mask].element()->~T();
+            for (size_t i = 0; i < memorySize; ++i) cellData[i].~Cell();
+            memResource->deallocate(cellData, sizeof(Cell) * memorySize, alignof(Cell));
+        }
+
+        bool push_back(const T &value) { return push_back(&value, 1) == 1; }
+
+        // 批量入队 [first, first + n) 的前缀, 一次 CAS 取得连续的槽位, 返回入队个数
+        size_t push_back(const T *first, size_t n) {
+            if (n == 0) return 0;
+            size_t pos;
+            size_t k = claim(enqueueIndex, n, 0, pos);
+            for (size_t i = 0; i < k; ++i) {
+                Cell &cell = cellData[(pos + i) & mask];
+                ::new(static_cast<void *>(cell.storage)) T(first[i]);
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return k;
+        }
+
+        bool pop_front(T &out) { return pop_front(&out, 1) == 1; }
+
+        // 批量出队至多 n 个元素到 out, 返回出队个数
+        size_t pop_front(T *out, size_t n) {
+            if (n == 0) return 0;
+            size_t pos;
+            size_t k = claim(dequeueIndex, n, 1, pos);
+            for (size_t i = 0; i < k; ++i) {
+                Cell &cell = cellData[(pos + i) & mask];
+                out[i] = std::move(*cell.element());
+                cell.element()->~T();
+                cell.sequence.store(pos + i + memorySize, std::memory_order_release);
+            }
+            return k;
+        }
+
+        size_t size() const {
+            size_t tail = enqueueIndex.value.load(std::memory_order_acquire);
+            size_t head = dequeueIndex.value.load(std::memory_order_acquire);
+            return (tail > head) ? tail - head : 0; // 并发时两次读取之间可能有出队
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return memorySize; }
+    };
+
+}
+
+#endif
@@ -3,11 +3,28 @@
 
 #include "exceptions.hpp"
 
+#include <bit> // std::bit_floor
 #include <cstddef>
-#include <cstring> // memset
+#include <cstring> // memcpy, memmove, memset
+#include <iterator> // std::begin, std::end
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility> // std::move
 
 //#define PAPERL_DEQUE_DEBUG
 
+#define DEQUE_FREE_BLOCK_LIMIT 8 // 每个 deque 最多缓存的空闲块数
+
+/**
+ * 模板参数 BLOCK_ELEMENT_NUMBER 为 0 (默认) 时, 块容量由字节预算决定: DEQUE_BLOCK_BYTES / sizeof(T),
+ *   但不少于 DEQUE_MIN_BLOCK_ELEMENTS; BLOCK_MERGE_BOUND 为 0 时取块容量的 1/4
+ * 块越大随机访问与遍历越快, 中间插入/删除的平移代价越高 (见 main.cpp 中的 dequeBlockSizeBenchmark)
+ */
+#define DEQUE_BLOCK_BYTES 4096
+#define DEQUE_MIN_BLOCK_ELEMENTS 8
+
 
 #ifdef PAPERL_DEQUE_DEBUG
 
@@ -17,146 +34,210 @@
 
 namespace sjtu {
 
-    template<class T, size_t BLOCK_ELEMENT_NUMBER = 128, size_t BLOCK_MERGE_BOUND = 32>
+    // 运行时指定 deque 的块形状, mergeBound 为 0 时取 elements / 4
+    struct deque_block_size {
+        size_t elements;
+        size_t mergeBound = 0;
+    };
+
+    /**
+     * 首块/末块变动时的回调 (见 deque::set_end_hook), 参数依次为 context, 原首块, 原末块, 新首块, 新末块,
+     *   deque 为空时首末块为空指针; 回调不应抛出异常, 也不应访问该 deque
+     */
+    struct deque_end_hook {
+        void (*func)(void *context, const void *oldHead, const void *oldTail,
+                     const void *newHead, const void *newTail) = nullptr;
+        void *context = nullptr;
+    };
+
+    namespace parallel {
+        template<class Deque>
+        struct deque_segments;
+    }
+
+    template<class T, size_t BLOCK_ELEMENT_NUMBER = 0, size_t BLOCK_MERGE_BOUND = 0>
     class deque {
+        template<class Deque> friend struct parallel::deque_segments; // 并行算法按块遍历
+
     public:
         class iterator;
 
     private:
         size_t totElementNumber;
+        std::pmr::memory_resource *memResource; // 块与元素均由此分配
+        std::pmr::memory_resource *indexResource; // 块目录由此分配
+        size_t blockCapacity, mergeBound; // 块形状, 同一 deque 的所有块容量相同
+
+        static constexpr bool trivialElement = std::is_trivially_copyable_v<T>;
+
+        static constexpr size_t defaultBlockCapacity() {
+            if constexpr (BLOCK_ELEMENT_NUMBER != 0) return BLOCK_ELEMENT_NUMBER;
+            else return (DEQUE_BLOCK_BYTES / sizeof(T) > DEQUE_MIN_BLOCK_ELEMENTS)
+                        ? DEQUE_BLOCK_BYTES / sizeof(T) : DEQUE_MIN_BLOCK_ELEMENTS;
+        }
+
+        void setBlockShape(deque_block_size shape) {
+            blockCapacity = (shape.elements >= 2) ? shape.elements : 2;
+            mergeBound = (shape.mergeBound != 0) ? shape.mergeBound : blockCapacity / 4;
+            if (mergeBound > blockCapacity) mergeBound = blockCapacity;
+        }
 
         // Unrolled Linked List Node
+        // 块头之后紧接着存放 blockCapacity 个元素的对齐缓冲区, 每个块只需一次分配
         class ULLBlock {
             friend class deque;
+            template<class Deque> friend struct parallel::deque_segments;
 
         private:
-            const size_t sizePtr = sizeof(T *);
-
             ULLBlock *preBlock, *nxtBlock;
             size_t elementNum;
-            T **elementData;
+            size_t slot; // 在块目录中的槽位
+
+            static constexpr size_t headerBytes = (sizeof(ULLBlock *) * 2 + sizeof(size_t) * 2 + alignof(T) - 1)
+                                                  / alignof(T) * alignof(T);
+
+            T *elementData() { return reinterpret_cast<T *>(reinterpret_cast<unsigned char *>(this) + headerBytes); }
 
-            void splitBlock() {
-                const size_t leftNum = BLOCK_ELEMENT_NUMBER / 2;
+            const T *elementData() const {
+                return reinterpret_cast<const T *>(reinterpret_cast<const unsigned char *>(this) + headerBytes);
+            }
+
+            // 将 [src, src + n) 搬到不重叠的 dest 处, 源位置视为已析构
+            static void relocate(T *dest, T *src, size_t n) {
+                if constexpr (trivialElement) {
+                    if (n > 0) memcpy(static_cast<void *>(dest), static_cast<const void *>(src), sizeof(T) * n);
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        ::new(static_cast<void *>(dest + i)) T(std::move(src[i]));
+                        src[i].~T();
+                    }
+                }
+            }
+
+            void splitBlock(deque *sub) {
+                const size_t leftNum = sub->blockCapacity / 2;
                 const size_t nxtNum = elementNum - leftNum;
-                ULLBlock *newBlock = new ULLBlock;
+                ULLBlock *newBlock = sub->acquireBlock();
 
                 newBlock->preBlock = this;
                 newBlock->nxtBlock = nxtBlock;
+                relocate(newBlock->elementData(), elementData() + leftNum, nxtNum);
                 newBlock->elementNum = nxtNum;
-                for (size_t i = leftNum; i < elementNum; ++i) {
-                    newBlock->elementData[i - leftNum] = elementData[i];
-                }
 
                 if (nxtBlock != nullptr) nxtBlock->preBlock = newBlock;
                 nxtBlock = newBlock;
 
-                memset(elementData + leftNum, 0, sizePtr * nxtNum);
                 elementNum = leftNum;
+                sub->indexInsertBlock(sub->blockPos(this) + 1, newBlock);
+                sub->indexCountChanged(this);
             }
 
-            void mergeBlock() {
-                for (size_t i = 0; i < nxtBlock->elementNum; ++i) {
-                    elementData[elementNum + i] = nxtBlock->elementData[i];
-                    nxtBlock->elementData[i] = nullptr;
-                }
+            void mergeBlock(deque *sub) {
+                sub->indexEraseBlock(sub->blockPos(this) + 1);
+                relocate(elementData() + elementNum, nxtBlock->elementData(), nxtBlock->elementNum);
                 elementNum += nxtBlock->elementNum;
+                nxtBlock->elementNum = 0;
                 if (nxtBlock->nxtBlock != nullptr) {
                     nxtBlock = nxtBlock->nxtBlock;
-                    delete nxtBlock->preBlock;
+                    sub->retireBlock(nxtBlock->preBlock);
                     nxtBlock->preBlock = this;
                 } else {
-                    delete nxtBlock;
+                    sub->retireBlock(nxtBlock);
                     nxtBlock = nullptr;
                 }
+                sub->indexCountChanged(this);
             }
 
         public:
-            ULLBlock() : preBlock(nullptr), nxtBlock(nullptr), elementNum(0) {
-                elementData = new T *[BLOCK_ELEMENT_NUMBER];
-                memset(elementData, 0, sizePtr * BLOCK_ELEMENT_NUMBER);
-            }
+            ULLBlock() : preBlock(nullptr), nxtBlock(nullptr), elementNum(0), slot(0) {}
 
-            ULLBlock(const ULLBlock &other) : ULLBlock() {
-                elementNum = other.elementNum;
-                for (size_t i = 0; i < elementNum; ++i)
-                    elementData[i] = new T(*(other.elementData[i]));
-            }
+            ULLBlock(const ULLBlock &other) = delete;
 
-            ~ULLBlock() {
-                for (size_t i = 0; i < elementNum; ++i)
-                    delete elementData[i];
-                delete[] elementData;
-            }
+            ~ULLBlock() { destroyElements(); }
 
-            ULLBlock &operator=(const ULLBlock &other) {
-                if (this == &other)return *this;
-                for (size_t i = 0; i < elementNum; ++i)
-                    delete elementData[i];
-                memset(elementData, 0, sizePtr * BLOCK_ELEMENT_NUMBER);
-                preBlock = nullptr;
-                nxtBlock = nullptr;
-                elementNum = other.elementNum;
-                for (size_t i = 0; i < elementNum; ++i)
-                    elementData[i] = new T(*(other.elementData[i]));
+            ULLBlock &operator=(const ULLBlock &other) = delete;
+
+            // 本块须为空
+            void copyElements(const ULLBlock &other) {
+                T *dest = elementData();
+                const T *src = other.elementData();
+                if constexpr (trivialElement) {
+                    if (other.elementNum > 0)
+                        memcpy(static_cast<void *>(dest), static_cast<const void *>(src), sizeof(T) * other.elementNum);
+                    elementNum = other.elementNum;
+                } else {
+                    for (; elementNum < other.elementNum; ++elementNum) // 构造失败时析构函数只销毁已构造的部分
+                        ::new(static_cast<void *>(dest + elementNum)) T(src[elementNum]);
+                }
             }
 
-            T *getElementPtr(size_t id) {
-                if (id >= elementNum) {
-                    if (nxtBlock == nullptr)throw index_out_of_bound();
-                    else return nxtBlock->getElementPtr(id - elementNum);
-                } else return elementData[id];
+            void destroyElements() {
+                if constexpr (!std::is_trivially_destructible_v<T>) {
+                    for (size_t i = 0; i < elementNum; ++i) elementData()[i].~T();
+                }
+                elementNum = 0;
             }
 
             T *getFrontElementPtr() {
                 if (elementNum == 0)throw runtime_error();
-                return elementData[0];
+                return elementData();
             }
 
             T *getBackElementPtr() {
                 if (elementNum == 0)throw runtime_error();
-                return elementData[elementNum - 1];
+                return elementData() + elementNum - 1;
             }
 
 
-            iterator insertElement(const T &arg, size_t id,
+            // value 按值传入: 即使原参数是本 deque 中的元素, 搬移元素后也不会失效
+            iterator insertElement(T value, size_t id,
                                    deque<T, BLOCK_ELEMENT_NUMBER, BLOCK_MERGE_BOUND> *sub,
                                    size_t idInDeque, ULLBlock *&tbp) { // tail block ptr
-                /*if (id > elementNum) {
-                    if (nxtBlock == nullptr)throw index_out_of_bound();
-                    else nxtBlock->insertElement(arg, id - elementNum);
-                } else {*/
                 if (id > elementNum)throw index_out_of_bound();
                 // todo 需要真正实现迭代器的 invalid 功能
-                if (elementNum == BLOCK_ELEMENT_NUMBER) {
-                    splitBlock();
+                if (elementNum == sub->blockCapacity) {
+                    splitBlock(sub);
                     if (nxtBlock->nxtBlock == nullptr) tbp = nxtBlock;
                     if (id > elementNum)
-                        return nxtBlock->insertElement(arg, id - elementNum,
+                        return nxtBlock->insertElement(std::move(value), id - elementNum,
                                                        sub, idInDeque, tbp);
                 }
-                for (size_t i = elementNum; i > id; --i)elementData[i] = elementData[i - 1];
-                elementData[id] = new T(arg);
+                T *data = elementData();
+                if constexpr (trivialElement) {
+                    if (elementNum > id)
+                        memmove(static_cast<void *>(data + id + 1), static_cast<const void *>(data + id),
+                                sizeof(T) * (elementNum - id));
+                    ::new(static_cast<void *>(data + id)) T(std::move(value));
+                } else if (id == elementNum) {
+                    ::new(static_cast<void *>(data + id)) T(std::move(value));
+                } else {
+                    ::new(static_cast<void *>(data + elementNum)) T(std::move(data[elementNum - 1]));
+                    for (size_t i = elementNum - 1; i > id; --i) data[i] = std::move(data[i - 1]);
+                    data[id] = std::move(value);
+                }
                 ++elementNum;
+                sub->indexCountChanged(this);
                 return iterator(sub, this, idInDeque, id);
             }
 
             iterator deleteElement(size_t id,
                                    deque<T, BLOCK_ELEMENT_NUMBER, BLOCK_MERGE_BOUND> *sub,
                                    size_t idInDeque, ULLBlock *&tbp) {
-                /*if (id >= elementNum) {
-                    if (nxtBlock == nullptr)throw index_out_of_bound();
-                    else nxtBlock->deleteElement(arg, id - elementNum);
-                } else {*/
                 if (id >= elementNum)throw index_out_of_bound();
-                delete elementData[id];
+                T *data = elementData();
+                if constexpr (trivialElement) {
+                    memmove(static_cast<void *>(data + id), static_cast<const void *>(data + id + 1),
+                            sizeof(T) * (elementNum - id - 1));
+                } else {
+                    for (size_t i = id; i + 1 < elementNum; ++i) data[i] = std::move(data[i + 1]);
+                    data[elementNum - 1].~T();
+                }
                 --elementNum;
-                for (size_t i = id; i < elementNum; ++i)elementData[i] = elementData[i + 1];
-                elementData[elementNum] = nullptr;
+                sub->indexCountChanged(this);
                 if (nxtBlock != nullptr &&
-                    (elementNum == 0 || elementNum + nxtBlock->elementNum < BLOCK_MERGE_BOUND)) {
+                    (elementNum == 0 || elementNum + nxtBlock->elementNum < sub->mergeBound)) {
                     if (nxtBlock == tbp)tbp = this;
-                    mergeBlock();
+                    mergeBlock(sub);
                 }
                 if (id != 0 && id == elementNum) { // 特判(首)块末/删至空块
                     if (this->nxtBlock != nullptr)
@@ -166,8 +247,377 @@ namespace sjtu {
             }
         };
 
+        static_assert(sizeof(ULLBlock) <= ULLBlock::headerBytes, "element buffer would overlap ULLBlock header");
+
         ULLBlock *headBlock, *tailBlock;
 
+        // 首末块变动后通知 endHook, hookHead/hookTail 为上次报告的首末块
+        deque_end_hook endHook;
+        const void *hookHead, *hookTail;
+
+        void syncEnds() {
+            if (endHook.func == nullptr || (headBlock == hookHead && tailBlock == hookTail)) return;
+            endHook.func(endHook.context, hookHead, hookTail, headBlock, tailBlock);
+            hookHead = headBlock, hookTail = tailBlock;
+        }
+
+        /**
+         * 空闲块链表 (经 nxtBlock 串联): 合并/删除产生的空块先放回这里, 分裂/新建时优先取用,
+         *   队列在块边界附近反复增减时不再向内存资源申请/归还块
+         */
+        ULLBlock *freeBlocks;
+        size_t freeBlockNum, poolHit, poolMiss;
+
+        size_t blockBytes() const { return ULLBlock::headerBytes + sizeof(T) * blockCapacity; }
+
+        static constexpr size_t blockAlign = (alignof(T) > alignof(ULLBlock)) ? alignof(T) : alignof(ULLBlock);
+
+        ULLBlock *createBlock() {
+            return ::new(memResource->allocate(blockBytes(), blockAlign)) ULLBlock();
+        }
+
+        void destroyBlock(ULLBlock *blockP) {
+            blockP->~ULLBlock();
+            memResource->deallocate(blockP, blockBytes(), blockAlign);
+        }
+
+        ULLBlock *acquireBlock() {
+            if (freeBlocks == nullptr) {
+                ++poolMiss;
+                return createBlock();
+            }
+            ++poolHit;
+            ULLBlock *blockP = freeBlocks;
+            freeBlocks = blockP->nxtBlock;
+            --freeBlockNum;
+            blockP->nxtBlock = nullptr;
+            return blockP;
+        }
+
+        void retireBlock(ULLBlock *blockP) {
+            if (freeBlockNum >= DEQUE_FREE_BLOCK_LIMIT) {
+                destroyBlock(blockP);
+                return;
+            }
+            blockP->destroyElements();
+            blockP->preBlock = nullptr;
+            blockP->nxtBlock = freeBlocks;
+            freeBlocks = blockP;
+            ++freeBlockNum;
+        }
+
+        void releaseFreeBlocks() {
+            while (freeBlocks != nullptr) {
+                ULLBlock *blockP = freeBlocks;
+                freeBlocks = blockP->nxtBlock;
+                destroyBlock(blockP);
+            }
+            freeBlockNum = 0;
+        }
+
+        /**
+         * 块目录: dirBlock[dirBegin, dirEnd) 按链表顺序保存全部块, 两端均留有空槽,
+         *   插入/删除块时只平移较短的一侧, 因此在首尾分裂/合并为 O(1)
+         * 各块的元素数记在 dirCount 中, 并以槽位为下标维护一个树状数组 dirTree (1 起, 区间外的槽位恒为 0):
+         *   块内元素数变化为 O(log 块数) 的单点修改, 按下标定位为一次 O(log 块数) 的树上二分, 且只读目录
+         * 末块的 push_back 不更新计数 (末块之后没有其他块, 滞后的计数不影响定位), 在其后接上新块时再补上
+         * 首块的计数同样允许滞后: 定位时先按实际元素数判断首块, 否则把下标平移到树中的坐标系,
+         *   在其前接上新块时再补上; 因此队列式的 push_back/pop_front 不触及树状数组
+         * 分裂/合并块使目录平移时, 平移的槽位少则逐个单点修改, 多则整体重建树状数组 (O(目录容量)),
+         *   后者只在中部分裂/合并时发生, 均摊到每次插入/删除上很小
+         */
+        ULLBlock **dirBlock;
+        size_t *dirCount;
+        size_t *dirTree;
+        size_t dirCapacity, dirBegin, dirEnd;
+
+        size_t blockPos(const ULLBlock *blockP) const { return blockP->slot - dirBegin; }
+
+        void treeAdd(size_t slot, size_t delta) { // delta 按无符号回绕, 可表示减少
+            for (size_t i = slot + 1; i <= dirCapacity; i += i & (~i + 1)) dirTree[i] += delta;
+        }
+
+        // 槽位 [0, slot) 的元素数之和
+        size_t treePrefix(size_t slot) const {
+            size_t sum = 0;
+            for (size_t i = slot; i > 0; i -= i & (~i + 1)) sum += dirTree[i];
+            return sum;
+        }
+
+        void treeRebuild() {
+            dirTree[0] = 0;
+            for (size_t i = 0; i < dirCapacity; ++i) dirTree[i + 1] = dirCount[i];
+            for (size_t i = 1; i <= dirCapacity; ++i) {
+                size_t parent = i + (i & (~i + 1));
+                if (parent <= dirCapacity) dirTree[parent] += dirTree[i];
+            }
+        }
+
+        void setCount(size_t slot, size_t num) {
+            treeAdd(slot, num - dirCount[slot]);
+            dirCount[slot] = num;
+        }
+
+        // 将 dirCount[src, src + num) 平移一个槽位至 dest, 空出的槽位计数为 0, 并同步树状数组
+        void moveCounts(size_t dest, size_t src, size_t num) {
+            if (num == 0) return;
+            if (num * std::bit_width(dirCapacity) < dirCapacity) {
+                if (dest < src) {
+                    for (size_t i = 0; i < num; ++i) setCount(dest + i, dirCount[src + i]);
+                    setCount(src + num - 1, 0);
+                } else {
+                    for (size_t i = num; i-- > 0;) setCount(dest + i, dirCount[src + i]);
+                    setCount(src, 0);
+                }
+            } else {
+                memmove(dirCount + dest, dirCount + src, sizeof(size_t) * num);
+                dirCount[(dest < src) ? src + num - 1 : src] = 0;
+                treeRebuild();
+            }
+        }
+
+        // 保证目录两端都至少有一个空槽
+        void indexReserve() {
+            if (dirBegin > 0 && dirEnd < dirCapacity) return;
+            size_t blockNum = dirEnd - dirBegin;
+            if (blockNum * 2 + 2 <= dirCapacity) { // 空槽足够, 原地居中
+                size_t newBegin = (dirCapacity - blockNum) / 2;
+                memmove(dirBlock + newBegin, dirBlock + dirBegin, sizeof(ULLBlock *) * blockNum);
+                memmove(dirCount + newBegin, dirCount + dirBegin, sizeof(size_t) * blockNum);
+                memset(static_cast<void *>(dirCount), 0, sizeof(size_t) * newBegin);
+                memset(static_cast<void *>(dirCount + newBegin + blockNum), 0,
+                       sizeof(size_t) * (dirCapacity - newBegin - blockNum));
+                dirBegin = newBegin;
+            } else {
+                size_t newCapacity = (dirCapacity * 2 > 8) ? dirCapacity * 2 : 8;
+                size_t newBegin = (newCapacity - blockNum) / 2;
+                auto newBlock = static_cast<ULLBlock **>(
+                        indexResource->allocate(sizeof(ULLBlock *) * newCapacity, alignof(ULLBlock *)));
+                auto newCount = static_cast<size_t *>(
+                        indexResource->allocate(sizeof(size_t) * newCapacity, alignof(size_t)));
+                auto newTree = static_cast<size_t *>(
+                        indexResource->allocate(sizeof(size_t) * (newCapacity + 1), alignof(size_t)));
+                memset(static_cast<void *>(newCount), 0, sizeof(size_t) * newCapacity);
+                if (blockNum > 0) {
+                    memcpy(newBlock + newBegin, dirBlock + dirBegin, sizeof(ULLBlock *) * blockNum);
+                    memcpy(newCount + newBegin, dirCount + dirBegin, sizeof(size_t) * blockNum);
+                }
+                indexRelease();
+                dirBlock = newBlock, dirCount = newCount, dirTree = newTree, dirCapacity = newCapacity;
+                dirBegin = newBegin;
+            }
+            dirEnd = dirBegin + blockNum;
+            for (size_t i = dirBegin; i < dirEnd; ++i) dirBlock[i]->slot = i;
+            treeRebuild();
+        }
+
+        void indexRelease() {
+            if (dirBlock == nullptr) return;
+            indexResource->deallocate(dirBlock, sizeof(ULLBlock *) * dirCapacity, alignof(ULLBlock *));
+            indexResource->deallocate(dirCount, sizeof(size_t) * dirCapacity, alignof(size_t));
+            indexResource->deallocate(dirTree, sizeof(size_t) * (dirCapacity + 1), alignof(size_t));
+            dirBlock = nullptr, dirCount = nullptr, dirTree = nullptr;
+        }
+
+        // 在第 pos 个块之前插入新块 (其余块的元素数须已记入目录, 末块除外)
+        void indexInsertBlock(size_t pos, ULLBlock *blockP) {
+            indexReserve();
+            size_t blockNum = dirEnd - dirBegin, slot = dirBegin + pos;
+            if (pos == blockNum && blockNum > 0) setCount(dirEnd - 1, dirBlock[dirEnd - 1]->elementNum); // 原末块
+            if (pos == 0 && blockNum > 0) setCount(dirBegin, dirBlock[dirBegin]->elementNum); // 原首块
+            if (pos < blockNum - pos) {
+                memmove(dirBlock + dirBegin - 1, dirBlock + dirBegin, sizeof(ULLBlock *) * pos);
+                moveCounts(dirBegin - 1, dirBegin, pos);
+                --dirBegin, --slot;
+                for (size_t i = dirBegin; i < slot; ++i) dirBlock[i]->slot = i;
+            } else {
+                memmove(dirBlock + slot + 1, dirBlock + slot, sizeof(ULLBlock *) * (blockNum - pos));
+                moveCounts(slot + 1, slot, blockNum - pos);
+                ++dirEnd;
+                for (size_t i = slot + 1; i < dirEnd; ++i) dirBlock[i]->slot = i;
+            }
+            dirBlock[slot] = blockP;
+            blockP->slot = slot;
+            setCount(slot, blockP->elementNum);
+        }
+
+        // 删除第 pos 个块
+        void indexEraseBlock(size_t pos) {
+            size_t blockNum = dirEnd - dirBegin, slot = dirBegin + pos;
+            setCount(slot, 0);
+            if (pos < blockNum - 1 - pos) {
+                memmove(dirBlock + dirBegin + 1, dirBlock + dirBegin, sizeof(ULLBlock *) * pos);
+                moveCounts(dirBegin + 1, dirBegin, pos);
+                ++dirBegin;
+                for (size_t i = dirBegin; i <= slot; ++i) dirBlock[i]->slot = i;
+            } else {
+                memmove(dirBlock + slot, dirBlock + slot + 1, sizeof(ULLBlock *) * (blockNum - 1 - pos));
+                moveCounts(slot, slot + 1, blockNum - 1 - pos);
+                --dirEnd;
+                for (size_t i = slot; i < dirEnd; ++i) dirBlock[i]->slot = i;
+            }
+        }
+
+        // 从末尾去掉 [pos, 块数) 的块
+        void indexTruncate(size_t pos) {
+            while (dirEnd > dirBegin + pos) setCount(--dirEnd, 0);
+        }
+
+        void indexCountChanged(ULLBlock *blockP) {
+            if (blockP->slot != dirBegin) setCount(blockP->slot, blockP->elementNum);
+        }
+
+        void indexClear() {
+            if (dirTree != nullptr) {
+                memset(static_cast<void *>(dirCount + dirBegin), 0, sizeof(size_t) * (dirEnd - dirBegin));
+                memset(static_cast<void *>(dirTree), 0, sizeof(size_t) * (dirCapacity + 1));
+            }
+            dirBegin = dirEnd = dirCapacity / 2;
+        }
+
+        // 将 pos 所在的块返回, 并把 pos 改为块内下标; pos == size() 时返回末块
+        ULLBlock *locateBlock(size_t &pos) const {
+            ULLBlock *head = dirBlock[dirBegin];
+            if (pos < head->elementNum) return head;
+            // 换算成树中 (首块计数可能滞后) 的下标, 其不小于首块的计数, 因此树上二分必然越过首块;
+            // 目录区间之前的槽位计数为 0, 树上二分得到的是最后一个前缀和 <= target 的槽位, 即跳过空块后的目标块
+            size_t target = pos - head->elementNum + dirCount[dirBegin];
+            size_t slot = 0, rest = target;
+            for (size_t step = std::bit_floor(dirCapacity); step > 0; step >>= 1)
+                if (slot + step <= dirCapacity && dirTree[slot + step] <= rest) slot += step, rest -= dirTree[slot];
+            if (slot >= dirEnd) { // 落在末块 (其计数可能滞后) 或 pos == size()
+                slot = dirEnd - 1;
+                rest = (slot == dirBegin) ? pos : target - treePrefix(slot);
+            }
+            pos = rest;
+            return dirBlock[slot];
+        }
+
+        // 块容量与内存资源相同时, 两个 deque 之间可以直接转移块而不搬移元素
+        bool sharesBlocksWith(const deque &other) const {
+            return blockCapacity == other.blockCapacity &&
+                   (memResource == other.memResource || memResource->is_equal(*other.memResource));
+        }
+
+        // 取走 other 的全部块, 本 deque 须为空且 sharesBlocksWith(other); other 变为空
+        // 块目录的内存资源也相同时一并取走块目录, 否则按块链表重建
+        void takeBlocks(deque &other) {
+            headBlock = other.headBlock, tailBlock = other.tailBlock;
+            totElementNumber = other.totElementNumber;
+            if (indexResource == other.indexResource || indexResource->is_equal(*other.indexResource)) {
+                indexRelease();
+                dirBlock = other.dirBlock, dirCount = other.dirCount, dirTree = other.dirTree;
+                dirCapacity = other.dirCapacity, dirBegin = other.dirBegin, dirEnd = other.dirEnd;
+                other.dirBlock = nullptr, other.dirCount = nullptr, other.dirTree = nullptr;
+                other.dirCapacity = other.dirBegin = other.dirEnd = 0;
+            } else {
+                indexClear();
+                for (ULLBlock *p = headBlock; p != nullptr; p = p->nxtBlock) indexInsertBlock(dirEnd - dirBegin, p);
+                other.indexClear();
+            }
+            other.headBlock = other.tailBlock = nullptr;
+            other.totElementNumber = 0;
+            other.syncEnds();
+            syncEnds();
+        }
+
+        // 块已全部转移给其他 deque 后, 将 other 重置为空
+        static void detachBlocks(deque &other) {
+            other.headBlock = other.tailBlock = nullptr;
+            other.totElementNumber = 0;
+            other.indexClear();
+            other.syncEnds();
+        }
+
+        void copyBlocks(const deque &other) {
+            ULLBlock *thisPtr = nullptr;
+            for (ULLBlock *otherPtr = other.headBlock; otherPtr != nullptr; otherPtr = otherPtr->nxtBlock) {
+                ULLBlock *newBlock = acquireBlock();
+                newBlock->copyElements(*otherPtr);
+                newBlock->preBlock = thisPtr;
+                if (thisPtr != nullptr) thisPtr->nxtBlock = newBlock;
+                else headBlock = newBlock;
+                indexInsertBlock(dirEnd - dirBegin, newBlock);
+                thisPtr = newBlock;
+            }
+            tailBlock = thisPtr;
+            syncEnds();
+        }
+
+
+        iterator insertValue(iterator pos, T value) {
+            //std::cout << "insert: " << pos.indexInDeque << ", " << pos.indexInBlock << ", "
+            //          << pos.blockPtr << std::endl;
+            if (this != pos.subject)throw invalid_iterator();
+            if (totElementNumber++ == 0) {
+                headBlock = acquireBlock(); // 首块生成/消亡, 或整体拼接/切分时 headBlock 才变动
+                tailBlock = headBlock;
+                indexInsertBlock(0, headBlock);
+                if (pos.indexInDeque != 0)throw index_out_of_bound();
+                headBlock->insertElement(std::move(value), 0,
+                                         this, pos.indexInDeque, tailBlock);
+                syncEnds();
+                return iterator(this, 0, false);
+            }
+            iterator result = pos.blockPtr->insertElement(std::move(value), pos.indexInBlock,
+                                                          pos.subject, pos.indexInDeque, tailBlock);
+            syncEnds(); // 分裂末块时 tailBlock 变动
+            return result;
+        }
+
+        // 在末尾直接构造一个元素: 末块已满时接上一个新块, 而不是像 insertElement 那样对半分裂
+        template<typename Arg>
+        void appendOne(Arg &&arg) {
+            if (tailBlock == nullptr || tailBlock->elementNum == blockCapacity) {
+                ULLBlock *newBlock = acquireBlock();
+                newBlock->preBlock = tailBlock;
+                if (tailBlock != nullptr) tailBlock->nxtBlock = newBlock;
+                else headBlock = newBlock;
+                tailBlock = newBlock;
+                indexInsertBlock(dirEnd - dirBegin, newBlock);
+                syncEnds();
+            }
+            try {
+                ::new(static_cast<void *>(tailBlock->elementData() + tailBlock->elementNum)) T(std::forward<Arg>(arg));
+            } catch (...) {
+                if (tailBlock->elementNum == 0) removeEmptyTail(); // 不留下空块
+                throw;
+            }
+            ++tailBlock->elementNum; // 末块的计数允许滞后 (见块目录的说明), 不必更新树状数组
+            ++totElementNumber;
+        }
+
+        void removeEmptyTail() {
+            ULLBlock *emptyBlock = tailBlock;
+            indexEraseBlock(blockPos(emptyBlock));
+            tailBlock = emptyBlock->preBlock;
+            if (tailBlock != nullptr) tailBlock->nxtBlock = nullptr;
+            else headBlock = nullptr;
+            retireBlock(emptyBlock);
+            syncEnds();
+        }
+
+        // 拼接处的两个相邻块之和不超过块容量且其中之一过小时合并为一块
+        void rebalanceSeam(ULLBlock *left) {
+            if (left == nullptr || left->nxtBlock == nullptr) return;
+            ULLBlock *right = left->nxtBlock;
+            if (left->elementNum + right->elementNum > blockCapacity) return;
+            if (left->elementNum >= mergeBound && right->elementNum >= mergeBound) return;
+            if (right == tailBlock) tailBlock = left;
+            left->mergeBlock(this);
+        }
+
+        deque emptyLike() const {
+            return deque(deque_block_size{blockCapacity, mergeBound}, memResource, indexResource);
+        }
+
+        // 将 middle (块形状与内存资源与本 deque 相同) 的全部块接入第 id 个元素之前, 两个拼接处由 splice_back 各自检查
+        void spliceAt(size_t id, deque &middle) {
+            if (middle.totElementNumber == 0) return;
+            deque right = split_at(id);
+            splice_back(std::move(middle));
+            splice_back(std::move(right));
+        }
 
     public:
         class const_iterator;
@@ -180,6 +630,24 @@ namespace sjtu {
             size_t indexInDeque;
             ULLBlock *blockPtr;
             size_t indexInBlock;
+
+            // 目标仍在当前块内时直接移动, 否则借助块目录定位; 越过 end() 时停在末块 (与原先一致)
+            void moveBy(long offset) {
+                if (offset == 0) return;
+                if (blockPtr == nullptr || (offset < 0 && size_t(-offset) > indexInDeque)) throw invalid_iterator();
+                size_t target = indexInDeque + offset;
+                if (offset > 0 ? indexInBlock + offset < blockPtr->elementNum : size_t(-offset) <= indexInBlock) {
+                    indexInBlock += offset;
+                } else if (target < subject->totElementNumber) {
+                    indexInBlock = target;
+                    blockPtr = subject->locateBlock(indexInBlock);
+                } else {
+                    blockPtr = subject->tailBlock;
+                    indexInBlock = target - (subject->totElementNumber - blockPtr->elementNum);
+                }
+                indexInDeque = target;
+            }
+
         public:
             iterator() : subject(nullptr), blockPtr(nullptr), indexInDeque(0), indexInBlock(0) {}
 
@@ -190,40 +658,15 @@ namespace sjtu {
                     indexInDeque = subject->totElementNumber;
                     blockPtr = subject->tailBlock;
                     indexInBlock = (blockPtr != nullptr) ? (blockPtr->elementNum) : 0;
-                } else {
-                    if (blockPtr != nullptr) {
-                        while (blockPtr->nxtBlock != nullptr && indexInBlock >= blockPtr->elementNum) {
-                            indexInBlock -= blockPtr->elementNum;
-                            blockPtr = blockPtr->nxtBlock;
-                        }
-                    }
+                } else if (blockPtr != nullptr) {
+                    if (indexInBlock >= subject->totElementNumber) { // 越界时与原先一样停在末块
+                        blockPtr = subject->tailBlock;
+                        indexInBlock -= subject->totElementNumber - blockPtr->elementNum;
+                    } else blockPtr = subject->locateBlock(indexInBlock);
                 }
             }
 
-            explicit iterator(const iterator &it, int offset) :
-                    subject(it.subject), blockPtr(it.blockPtr),
-                    indexInDeque(it.indexInDeque + offset), indexInBlock(it.indexInBlock) {
-                if (offset > 0) {
-                    indexInBlock += offset;
-                    while (blockPtr->nxtBlock != nullptr && indexInBlock >= blockPtr->elementNum) {
-                        indexInBlock = indexInBlock - blockPtr->elementNum;
-                        blockPtr = blockPtr->nxtBlock;
-                    }
-                } else if (offset < 0) {
-                    offset = -offset;
-                    if (offset > indexInBlock) {
-                        offset -= indexInBlock + 1;
-                        blockPtr = blockPtr->preBlock;
-                        if (blockPtr == nullptr) throw invalid_iterator();
-                        while (offset >= blockPtr->elementNum) {
-                            offset -= blockPtr->elementNum;
-                            blockPtr = blockPtr->preBlock;
-                            if (blockPtr == nullptr) throw invalid_iterator();
-                        }
-                        indexInBlock = blockPtr->elementNum - 1 - offset;
-                    } else indexInBlock -= offset;
-                }
-            }
+            explicit iterator(const iterator &it, int offset) : iterator(it) { moveBy(offset); }
 
             explicit iterator(deque<T, BLOCK_ELEMENT_NUMBER, BLOCK_MERGE_BOUND> *sub,
                               ULLBlock *blockP, size_t idInDeque, size_t idInBlock) :
@@ -251,34 +694,46 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
             }
 
             iterator &operator+=(const int &n) {
-                *this = iterator(*this, n);
+                moveBy(n);
                 return *this;
             }
 
             iterator &operator-=(const int &n) {
-                *this = iterator(*this, -n);
+                moveBy(-n);
                 return *this;
             }
 
             iterator operator++(int) {
                 iterator tempIt(*this);
-                *this = iterator(*this, 1);
+                ++*this;
                 return tempIt;
             }// iter++
 
             iterator &operator++() {
-                *this = iterator(*this, 1);
+                if (blockPtr == nullptr) throw invalid_iterator();
+                ++indexInDeque;
+                if (++indexInBlock >= blockPtr->elementNum && blockPtr->nxtBlock != nullptr) {
+                    blockPtr = blockPtr->nxtBlock;
+                    indexInBlock = 0;
+                }
                 return *this;
             }// ++iter
 
             iterator operator--(int) {
                 iterator tempIt(*this);
-                *this = iterator(*this, -1);
+                --*this;
                 return tempIt;
             }// iter--
 
             iterator &operator--() {
-                *this = iterator(*this, -1);
+                if (blockPtr == nullptr) throw invalid_iterator();
+                if (indexInBlock == 0) {
+                    if (blockPtr->preBlock == nullptr) throw invalid_iterator();
+                    blockPtr = blockPtr->preBlock;
+                    indexInBlock = blockPtr->elementNum;
+                }
+                --indexInBlock;
+                --indexInDeque;
                 return *this;
             }// --iter
 
@@ -287,9 +742,8 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
              * 		throw if iterator is invalid
              */
             T &operator*() const {
-                if (indexInBlock >= blockPtr->elementNum) {
-                    throw invalid_iterator();
-                } else return *(blockPtr->getElementPtr(indexInBlock));
+                if (indexInBlock >= blockPtr->elementNum) throw invalid_iterator();
+                return blockPtr->elementData()[indexInBlock];
             }
 
             /**
@@ -325,6 +779,24 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
             size_t indexInDeque;
             ULLBlock *blockPtr;
             size_t indexInBlock;
+
+            // 目标仍在当前块内时直接移动, 否则借助块目录定位; 越过 end() 时停在末块 (与原先一致)
+            void moveBy(long offset) {
+                if (offset == 0) return;
+                if (blockPtr == nullptr || (offset < 0 && size_t(-offset) > indexInDeque)) throw invalid_iterator();
+                size_t target = indexInDeque + offset;
+                if (offset > 0 ? indexInBlock + offset < blockPtr->elementNum : size_t(-offset) <= indexInBlock) {
+                    indexInBlock += offset;
+                } else if (target < subject->totElementNumber) {
+                    indexInBlock = target;
+                    blockPtr = subject->locateBlock(indexInBlock);
+                } else {
+                    blockPtr = subject->tailBlock;
+                    indexInBlock = target - (subject->totElementNumber - blockPtr->elementNum);
+                }
+                indexInDeque = target;
+            }
+
         public:
             const_iterator() : subject(nullptr), blockPtr(nullptr), indexInDeque(0), indexInBlock(0) {}
 
@@ -335,39 +807,15 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
                     indexInDeque = subject->totElementNumber;
                     blockPtr = subject->tailBlock;
                     indexInBlock = (blockPtr != nullptr) ? (blockPtr->elementNum) : 0;
-                } else {
-                    if (blockPtr != nullptr) {
-                        while (blockPtr->nxtBlock != nullptr && indexInBlock >= blockPtr->elementNum) {
-                            indexInBlock -= blockPtr->elementNum;
-                            blockPtr = blockPtr->nxtBlock;
-                        }
-                    }
+                } else if (blockPtr != nullptr) {
+                    if (indexInBlock >= subject->totElementNumber) { // 越界时与原先一样停在末块
+                        blockPtr = subject->tailBlock;
+                        indexInBlock -= subject->totElementNumber - blockPtr->elementNum;
+                    } else blockPtr = subject->locateBlock(indexInBlock);
                 }
             }
 
-            explicit const_iterator(const const_iterator &it, int offset) :
-                    subject(it.subject), blockPtr(it.blockPtr),
-                    indexInDeque(it.indexInDeque + offset), indexInBlock(it.indexInBlock) {
-                if (offset > 0) {
-                    indexInBlock += offset;
-                    while (blockPtr->nxtBlock != nullptr && indexInBlock >= blockPtr->elementNum) {
-                        indexInBlock = indexInBlock - blockPtr->elementNum;
-                        blockPtr = blockPtr->nxtBlock;
-                    }
-                } else if (offset < 0) {
-                    offset = -offset;
-                    if (offset > indexInBlock) {
-                        offset -= indexInBlock + 1;
-                        blockPtr = blockPtr->preBlock;
-                        if (blockPtr == nullptr) throw invalid_iterator();
-                        while (offset >= blockPtr->elementNum) {
-                            offset -= blockPtr->elementNum;
-                            blockPtr = blockPtr->preBlock;
-                        }
-                        indexInBlock = blockPtr->elementNum - offset - 1;
-                    } else indexInBlock -= offset;
-                }
-            }
+            explicit const_iterator(const const_iterator &it, int offset) : const_iterator(it) { moveBy(offset); }
 
             explicit const_iterator(deque<T, BLOCK_ELEMENT_NUMBER, BLOCK_MERGE_BOUND> *sub,
                                     ULLBlock *blockP, size_t idInDeque, size_t idInBlock) :
@@ -383,41 +831,52 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
             }
 
             const_iterator &operator+=(const int &n) {
-                *this = const_iterator(*this, n);
+                moveBy(n);
                 return *this;
             }
 
             const_iterator &operator-=(const int &n) {
-                *this = const_iterator(*this, -n);
+                moveBy(-n);
                 return *this;
             }
 
             const_iterator operator++(int) {
                 const_iterator tempIt(*this);
-                *this = const_iterator(*this, 1);
+                ++*this;
                 return tempIt;
             }// iter++
 
             const_iterator &operator++() {
-                *this = const_iterator(*this, 1);
+                if (blockPtr == nullptr) throw invalid_iterator();
+                ++indexInDeque;
+                if (++indexInBlock >= blockPtr->elementNum && blockPtr->nxtBlock != nullptr) {
+                    blockPtr = blockPtr->nxtBlock;
+                    indexInBlock = 0;
+                }
                 return *this;
             }// ++iter
 
             const_iterator operator--(int) {
                 const_iterator tempIt(*this);
-                *this = const_iterator(*this, -1);
+                --*this;
                 return tempIt;
             }// iter--
 
             const_iterator &operator--() {
-                *this = const_iterator(*this, -1);
+                if (blockPtr == nullptr) throw invalid_iterator();
+                if (indexInBlock == 0) {
+                    if (blockPtr->preBlock == nullptr) throw invalid_iterator();
+                    blockPtr = blockPtr->preBlock;
+                    indexInBlock = blockPtr->elementNum;
+                }
+                --indexInBlock;
+                --indexInDeque;
                 return *this;
             }// --iter
 
             const T &operator*() const {
-                if (indexInBlock >= blockPtr->elementNum)
-                    throw invalid_iterator();
-                else return *(blockPtr->getElementPtr(indexInBlock));
+                if (indexInBlock >= blockPtr->elementNum) throw invalid_iterator();
+                return blockPtr->elementData()[indexInBlock];
             }
 
             const T *operator->() const noexcept { return &(operator*()); }
@@ -435,63 +894,87 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
             bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
         };
 
-        deque() : totElementNumber(0), headBlock(nullptr), tailBlock(nullptr) {}
-
-        deque(const deque &other) : totElementNumber(other.totElementNumber) {
-            if (other.headBlock != nullptr) {
-                headBlock = new ULLBlock(*(other.headBlock));
-                ULLBlock *thisPtr = headBlock, *otherPtr = other.headBlock;
-                while (otherPtr->nxtBlock != nullptr) {
-                    otherPtr = otherPtr->nxtBlock;
-                    thisPtr->nxtBlock = new ULLBlock(*otherPtr);
-                    thisPtr->nxtBlock->preBlock = thisPtr;
-                    thisPtr = thisPtr->nxtBlock;
-                }
-                tailBlock = thisPtr;
-            } else {
-                headBlock = nullptr;
-                tailBlock = nullptr;
-            }
+        deque() : deque(std::pmr::get_default_resource()) {}
+
+        // 全部内存由 res 分配, 如传入 monotonic_buffer_resource 可整体丢弃
+        // indexRes 非空时块目录改由 indexRes 分配 (如块存放在文件中, 而块目录须留在内存中, 见 spill_resource.hpp)
+        explicit deque(std::pmr::memory_resource *res, std::pmr::memory_resource *indexRes = nullptr)
+                : deque(deque_block_size{defaultBlockCapacity(), BLOCK_MERGE_BOUND}, res, indexRes) {}
+
+        // 运行时覆盖模板参数给出的块形状
+        explicit deque(deque_block_size shape, std::pmr::memory_resource *res = std::pmr::get_default_resource(),
+                       std::pmr::memory_resource *indexRes = nullptr)
+                : totElementNumber(0), memResource(res), indexResource((indexRes != nullptr) ? indexRes : res),
+                  blockCapacity(0), mergeBound(0),
+                  headBlock(nullptr), tailBlock(nullptr), endHook(), hookHead(nullptr), hookTail(nullptr),
+                  freeBlocks(nullptr), freeBlockNum(0), poolHit(0), poolMiss(0),
+                  dirBlock(nullptr), dirCount(nullptr), dirTree(nullptr), dirCapacity(0), dirBegin(0), dirEnd(0) {
+            setBlockShape(shape);
+        }
+
+        // 与 std::pmr 容器一致, 拷贝构造使用默认内存资源
+        deque(const deque &other) : deque(other, std::pmr::get_default_resource()) {}
+
+        deque(const deque &other, std::pmr::memory_resource *res)
+                : totElementNumber(other.totElementNumber), memResource(res), indexResource(res),
+                  blockCapacity(other.blockCapacity), mergeBound(other.mergeBound),
+                  headBlock(nullptr), tailBlock(nullptr), endHook(), hookHead(nullptr), hookTail(nullptr),
+                  freeBlocks(nullptr), freeBlockNum(0), poolHit(0), poolMiss(0),
+                  dirBlock(nullptr), dirCount(nullptr), dirTree(nullptr), dirCapacity(0), dirBegin(0), dirEnd(0) {
+            copyBlocks(other);
+        }
+
+        // 直接取走 other 的全部块, other 变为空 (仍可继续使用); 首末块回调一并带走
+        deque(deque &&other) noexcept
+                : deque(deque_block_size{other.blockCapacity, other.mergeBound}, other.memResource,
+                        other.indexResource) {
+            endHook = other.endHook;
+            takeBlocks(other);
         }
 
-        ~deque() { clear(); }
+        ~deque() {
+            clear();
+            indexRelease();
+            releaseFreeBlocks();
+        }
 
 
         deque &operator=(const deque &other) {
             if (this == &other)return *this;
             clear();
+            if (blockCapacity != other.blockCapacity) releaseFreeBlocks(); // 缓存的块大小不再适用
+            blockCapacity = other.blockCapacity, mergeBound = other.mergeBound;
             totElementNumber = other.totElementNumber;
-            if (other.headBlock != nullptr) {
-                headBlock = new ULLBlock(*(other.headBlock));
-                ULLBlock *thisPtr = headBlock, *otherPtr = other.headBlock;
-                while (otherPtr->nxtBlock != nullptr) {
-                    otherPtr = otherPtr->nxtBlock;
-                    thisPtr->nxtBlock = new ULLBlock(*otherPtr);
-                    thisPtr->nxtBlock->preBlock = thisPtr;
-                    thisPtr = thisPtr->nxtBlock;
-                }
-                tailBlock = thisPtr;
-            } else {
-                headBlock = nullptr;
-                tailBlock = nullptr;
-            }
+            copyBlocks(other);
+            return *this;
+        }
+
+        // 保留本 deque 的内存资源与块形状, 二者与 other 相同时直接取走其块, 否则逐个移动元素
+        deque &operator=(deque &&other) {
+            if (this == &other)return *this;
+            clear();
+            splice_back(std::move(other));
             return *this;
         }
 
 
         T &at(const size_t &pos) {
-            if (totElementNumber == 0)throw index_out_of_bound();
-            else return *(headBlock->getElementPtr(pos));
+            if (pos >= totElementNumber)throw index_out_of_bound();
+            size_t idInBlock = pos;
+            ULLBlock *blockPtr = locateBlock(idInBlock);
+            return blockPtr->elementData()[idInBlock];
         }
 
         const T &at(const size_t &pos) const {
-            if (totElementNumber == 0)throw index_out_of_bound();
-            else return *(headBlock->getElementPtr(pos));
+            if (pos >= totElementNumber)throw index_out_of_bound();
+            size_t idInBlock = pos;
+            ULLBlock *blockPtr = locateBlock(idInBlock);
+            return blockPtr->elementData()[idInBlock];
         }
 
-        T &operator[](const size_t &pos) { return *(headBlock->getElementPtr(pos)); }
+        T &operator[](const size_t &pos) { return at(pos); }
 
-        const T &operator[](const size_t &pos) const { return *(headBlock->getElementPtr(pos)); }
+        const T &operator[](const size_t &pos) const { return at(pos); }
 
 
         const T &front() const {
@@ -528,6 +1011,63 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
          */
         size_t size() const { return totElementNumber; }
 
+        std::pmr::memory_resource *resource() const { return memResource; }
+
+        std::pmr::memory_resource *index_resource() const { return indexResource; }
+
+        size_t block_capacity() const { return blockCapacity; }
+
+        struct block_pool_stats {
+            size_t hit;    // 取自空闲块链表的次数
+            size_t miss;   // 向内存资源申请新块的次数
+            size_t cached; // 当前缓存的空闲块数
+        };
+
+        block_pool_stats pool_stats() const { return {poolHit, poolMiss, freeBlockNum}; }
+
+        /**
+         * 设置首末块变动时的回调, 并立即报告当前的首末块; 原回调先收到一次首末块变为空的报告
+         * 移动构造与 split_at 得到的 deque 沿用同一回调, 析构时报告首末块变为空
+         */
+        void set_end_hook(deque_end_hook hook) {
+            if (endHook.func != nullptr && (hookHead != nullptr || hookTail != nullptr))
+                endHook.func(endHook.context, hookHead, hookTail, nullptr, nullptr);
+            endHook = hook;
+            hookHead = hookTail = nullptr;
+            syncEnds();
+        }
+
+        /**
+         * 按顺序对每个非空块调用 func(std::span<T>), 每个 span 是一段连续内存, 可以直接做向量化计算或 memcpy
+         * func 中不应增删本 deque 的元素
+         */
+        template<typename Func>
+        void for_each_block(Func &&func) {
+            for (ULLBlock *p = headBlock; p != nullptr; p = p->nxtBlock)
+                if (p->elementNum != 0) func(std::span<T>(p->elementData(), p->elementNum));
+        }
+
+        template<typename Func>
+        void for_each_block(Func &&func) const {
+            for (const ULLBlock *p = headBlock; p != nullptr; p = p->nxtBlock)
+                if (p->elementNum != 0) func(std::span<const T>(p->elementData(), p->elementNum));
+        }
+
+        // 只访问 [first, last), 首尾两段可能是块的一部分
+        template<typename Func>
+        void for_each_block(iterator first, iterator last, Func &&func) {
+            if (this != first.subject || this != last.subject)throw invalid_iterator();
+            if (first.indexInDeque > last.indexInDeque || last.indexInDeque > totElementNumber)
+                throw index_out_of_bound();
+            size_t remain = last.indexInDeque - first.indexInDeque;
+            ULLBlock *p = first.blockPtr;
+            for (size_t begin = first.indexInBlock; remain != 0; p = p->nxtBlock, begin = 0) {
+                size_t len = (p->elementNum - begin < remain) ? p->elementNum - begin : remain;
+                if (len != 0) func(std::span<T>(p->elementData() + begin, len));
+                remain -= len;
+            }
+        }
+
         /**
          * clears the contents
          */
@@ -536,13 +1076,15 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
                 ULLBlock *blockPtr = headBlock;
                 while (blockPtr->nxtBlock != nullptr) {
                     blockPtr = blockPtr->nxtBlock;
-                    delete blockPtr->preBlock;
+                    retireBlock(blockPtr->preBlock);
                 }
-                delete blockPtr;
+                retireBlock(blockPtr);
+                indexClear();
 
                 totElementNumber = 0;
                 headBlock = nullptr;
                 tailBlock = nullptr;
+                syncEnds();
             }
         }
 
@@ -552,21 +1094,7 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
          * returns an iterator pointing to the inserted value
          *     throw if the iterator is invalid or it point to a wrong place.
          */
-        iterator insert(iterator pos, const T &value) {
-            //std::cout << "insert: " << pos.indexInDeque << ", " << pos.indexInBlock << ", "
-            //          << pos.blockPtr << std::endl;
-            if (this != pos.subject)throw invalid_iterator();
-            if (totElementNumber++ == 0) {
-                headBlock = new ULLBlock; // headBlock 仅在首块生成/消亡时变动
-                tailBlock = headBlock;
-                if (pos.indexInDeque != 0)throw index_out_of_bound();
-                headBlock->insertElement(value, 0,
-                                         this, pos.indexInDeque, tailBlock);
-                return iterator(this, 0, false);
-            } else
-                return pos.blockPtr->insertElement(value, pos.indexInBlock,
-                                                   pos.subject, pos.indexInDeque, tailBlock);
-        }
+        iterator insert(iterator pos, const T &value) { return insertValue(pos, value); }
 
         /**
          * removes specified element at pos.
@@ -583,22 +1111,25 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
             if (tempIt.blockPtr->elementNum == 0) {
                 if (tempIt.blockPtr->preBlock != nullptr) {// 删除末块
                     tempIt.blockPtr = tempIt.blockPtr->preBlock;
-                    delete tempIt.blockPtr->nxtBlock;
+                    indexEraseBlock(blockPos(tempIt.blockPtr) + 1);
+                    retireBlock(tempIt.blockPtr->nxtBlock);
                     tempIt.blockPtr->nxtBlock = nullptr;
                     tailBlock = tempIt.blockPtr;
                     tempIt.indexInBlock = tempIt.blockPtr->elementNum - 1;
                 } else {
                     headBlock = nullptr;
                     tailBlock = nullptr;
-                    delete tempIt.blockPtr;
+                    indexClear();
+                    retireBlock(tempIt.blockPtr);
                     tempIt = iterator(pos.subject, nullptr, 0, 0);
                 }
             }
             --totElementNumber;
+            syncEnds();
             return tempIt;
         }
 
-        void push_back(const T &value) { insert(end(), value); }
+        void push_back(const T &value) { appendOne(value); } // 末块已满时接上新块, 而不是对半分裂
 
         void pop_back() {
             if (totElementNumber == 0)throw container_is_empty(); // --end()会出错
@@ -609,6 +1140,177 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
 
         void pop_front() { erase(begin()); }
 
+        /**
+         * 将 other 的全部元素接到末尾 (开头), other 变为空
+         * 内存资源与块容量相同时只重新链接块, 不搬移元素, 代价为 other 的块数; 否则逐个移动元素
+         * 拼接处的两个块过小时合并为一块, 以维持 BLOCK_MERGE_BOUND 的约束
+         * other 的迭代器全部失效
+         */
+        void splice_back(deque &&other) {
+            if (this == &other || other.totElementNumber == 0) return;
+            if (!sharesBlocksWith(other)) {
+                for (T &value:other) appendOne(std::move(value));
+                other.clear();
+                return;
+            }
+            if (totElementNumber == 0) {
+                takeBlocks(other);
+                return;
+            }
+            ULLBlock *seam = tailBlock;
+            tailBlock->nxtBlock = other.headBlock;
+            other.headBlock->preBlock = tailBlock;
+            for (ULLBlock *p = other.headBlock; p != nullptr; p = p->nxtBlock) indexInsertBlock(dirEnd - dirBegin, p);
+            tailBlock = other.tailBlock;
+            totElementNumber += other.totElementNumber;
+            detachBlocks(other);
+            rebalanceSeam(seam);
+            syncEnds();
+        }
+
+        void splice_front(deque &&other) {
+            if (this == &other || other.totElementNumber == 0) return;
+            if (!sharesBlocksWith(other)) { // 先按本 deque 的块形状整块装入, 再一次性接到开头
+                deque middle = emptyLike();
+                for (T &value:other) middle.appendOne(std::move(value));
+                spliceAt(0, middle);
+                other.clear();
+                return;
+            }
+            if (totElementNumber == 0) {
+                takeBlocks(other);
+                return;
+            }
+            ULLBlock *seam = other.tailBlock;
+            other.tailBlock->nxtBlock = headBlock;
+            headBlock->preBlock = other.tailBlock;
+            for (ULLBlock *p = other.tailBlock; p != nullptr; p = p->preBlock) indexInsertBlock(0, p);
+            headBlock = other.headBlock;
+            totElementNumber += other.totElementNumber;
+            detachBlocks(other);
+            rebalanceSeam(seam);
+            syncEnds();
+        }
+
+        /**
+         * 将 [first, last) 插入至 pos 之前: 新元素先整块填入临时块链, 再在 pos 处切开一次并拼接,
+         *   最后只在两个拼接处各做一次合并检查
+         * returns an iterator pointing to the first inserted value
+         */
+        template<typename InputIt>
+        requires (!std::is_integral_v<InputIt>)
+        iterator insert(iterator pos, InputIt first, InputIt last) {
+            if (this != pos.subject)throw invalid_iterator();
+            size_t id = pos.indexInDeque;
+            if (id > totElementNumber)throw index_out_of_bound();
+            deque middle = emptyLike();
+            for (; first != last; ++first) middle.appendOne(*first);
+            spliceAt(id, middle);
+            return iterator(this, id);
+        }
+
+        iterator insert(iterator pos, const size_t &n, const T &value) {
+            if (this != pos.subject)throw invalid_iterator();
+            size_t id = pos.indexInDeque;
+            if (id > totElementNumber)throw index_out_of_bound();
+            deque middle = emptyLike();
+            for (size_t i = 0; i < n; ++i) middle.appendOne(value);
+            spliceAt(id, middle);
+            return iterator(this, id);
+        }
+
+        /**
+         * 删除 [first, last): 至多切开两个块, 中间的块整块回收, 再做一次合并检查
+         * returns an iterator pointing to the element following the erased ones
+         */
+        iterator erase(iterator first, iterator last) {
+            if (this != first.subject || this != last.subject)throw invalid_iterator();
+            size_t firstId = first.indexInDeque, lastId = last.indexInDeque;
+            if (firstId > lastId || lastId > totElementNumber)throw index_out_of_bound();
+            if (firstId == lastId) return iterator(this, firstId);
+            deque right = split_at(lastId);
+            deque middle = split_at(firstId);
+            for (ULLBlock *p = middle.headBlock; p != nullptr;) {
+                ULLBlock *nxt = p->nxtBlock;
+                retireBlock(p);
+                p = nxt;
+            }
+            detachBlocks(middle);
+            ULLBlock *seam = tailBlock;
+            splice_back(std::move(right));
+            rebalanceSeam(seam);
+            syncEnds();
+            return iterator(this, firstId);
+        }
+
+        /**
+         * 在末尾 (开头) 追加任意提供 begin()/end() 的区间, 新元素整块填充
+         * 区间不应为本 deque 自身
+         */
+        template<typename Range>
+        void append_range(Range &&range) {
+            ULLBlock *seam = tailBlock;
+            for (auto it = std::begin(range), itEnd = std::end(range); it != itEnd; ++it) appendOne(*it);
+            rebalanceSeam(seam);
+            syncEnds();
+        }
+
+        template<typename Range>
+        void prepend_range(Range &&range) {
+            deque middle = emptyLike();
+            for (auto it = std::begin(range), itEnd = std::end(range); it != itEnd; ++it) middle.appendOne(*it);
+            spliceAt(0, middle);
+        }
+
+        /**
+         * 将 [pos, size()) 切下并作为新的 deque 返回 (与本 deque 使用相同的内存资源, 块形状与首末块回调),
+         *   本 deque 保留 [0, pos)
+         * 至多切开一个块, 其余块直接转移, 代价为 O(块容量 + 转移的块数)
+         * throw if pos > size()
+         */
+        deque split_at(size_t pos) {
+            if (pos > totElementNumber)throw index_out_of_bound();
+            deque result = emptyLike();
+            result.endHook = endHook;
+            if (pos == totElementNumber) return result;
+            size_t idInBlock = pos;
+            ULLBlock *first = locateBlock(idInBlock);
+            if (idInBlock > 0) { // 切开 pos 所在的块
+                ULLBlock *newBlock = acquireBlock();
+                ULLBlock::relocate(newBlock->elementData(), first->elementData() + idInBlock,
+                                   first->elementNum - idInBlock);
+                newBlock->elementNum = first->elementNum - idInBlock;
+                first->elementNum = idInBlock;
+                newBlock->preBlock = first;
+                newBlock->nxtBlock = first->nxtBlock;
+                if (first->nxtBlock != nullptr) first->nxtBlock->preBlock = newBlock;
+                else tailBlock = newBlock;
+                first->nxtBlock = newBlock;
+                indexInsertBlock(blockPos(first) + 1, newBlock);
+                indexCountChanged(first);
+                first = newBlock;
+            }
+            size_t firstPos = blockPos(first);
+            for (ULLBlock *p = first; p != nullptr; p = p->nxtBlock)
+                result.indexInsertBlock(result.dirEnd - result.dirBegin, p);
+            result.headBlock = first;
+            result.tailBlock = tailBlock;
+            result.totElementNumber = totElementNumber - pos;
+            totElementNumber = pos;
+            if (firstPos == 0) {
+                headBlock = tailBlock = nullptr;
+                indexClear();
+            } else {
+                tailBlock = first->preBlock;
+                tailBlock->nxtBlock = nullptr;
+                first->preBlock = nullptr;
+                indexTruncate(firstPos);
+            }
+            syncEnds();
+            result.syncEnds();
+            return result;
+        }
+
 #ifdef PAPERL_DEQUE_DEBUG
 
         void debugPrint() {
@@ -619,10 +1321,10 @@ if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出
             while (_p != nullptr) {
                 std::cout << "=== num: " << _p->elementNum << ", address: " << _p << std::endl;
                 std::cout << "nxt: " << _p->nxtBlock << ", pre: " << _p->preBlock << std::endl;
-                for (int _i = 0; _i < BLOCK_ELEMENT_NUMBER; ++_i) {
-                    if (_p->elementData[_i] == nullptr)
+                for (size_t _i = 0; _i < blockCapacity; ++_i) {
+                    if (_i >= _p->elementNum)
                         std::cout << "NULL" << "\t";
-                    else std::cout << *(_p->elementData[_i]) << "\t";
+                    else std::cout << _p->elementData()[_i] << "\t";
                     if (_i % 5 == 4)std::cout << std::endl;
                 }
                 _p = _p->nxtBlock;
@@ -4,15 +4,30 @@
 #include "exceptions.hpp"
 
 #include "vector.hpp"
+#include "small_vector.hpp"
 #include "priority_queue.hpp"
 #include "deque.hpp"
 #include "segment_tree.hpp"
 #include "map.hpp"
+#include "parallel.hpp"
+#include "concurrent_queue.hpp"
+#include "work_stealing.hpp"
+#include "spill_resource.hpp"
 
 #include <cmath>
 
 #include "PTF.hpp"
 
+#ifdef PTL_BENCHMARK
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#endif
+
 using namespace sjtu;
 using namespace PTF;
 using namespace PTL;
@@ -254,6 +269,484 @@ void mapTest() {
 }
 */
 
+#ifdef PTL_BENCHMARK
+
+template<typename Func>
+double benchTime(Func &&func) { // 返回耗时 (ms)
+    auto startTime = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void vectorBenchmark() {
+    const int n = 1000000, rounds = 20;
+    long long checkSum = 0;
+
+    // 旧实现的布局: 指针数组 + 每个元素单独 new
+    std::vector<int *> boxed;
+    double boxedPush = benchTime([&] { for (int i = 0; i < n; ++i) boxed.push_back(new int(i)); });
+    double boxedIter = benchTime([&] {
+        for (int r = 0; r < rounds; ++r) for (int *p:boxed) checkSum += *p;
+    });
+    for (int *p:boxed) delete p;
+
+    sjtu::vector<int> inlineVec;
+    double inlinePush = benchTime([&] { for (int i = 0; i < n; ++i) inlineVec.push_back(i); });
+    double inlineIter = benchTime([&] {
+        for (int r = 0; r < rounds; ++r) for (int x:inlineVec) checkSum += x;
+    });
+
+    std::cout << "[vector] n = " << n << ", iteration rounds = " << rounds << std::endl;
+    std::cout << "  boxed  push_back: " << boxedPush << " ms, iterate: " << boxedIter << " ms" << std::endl;
+    std::cout << "  inline push_back: " << inlinePush << " ms, iterate: " << inlineIter << " ms" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+// 与 int 布局相同但拷贝构造非平凡, 用于对比 vector 的逐元素拷贝路径
+struct NonTrivialInt {
+    int value;
+
+    NonTrivialInt(int v) : value(v) {}
+
+    NonTrivialInt(const NonTrivialInt &other) : value(other.value) {}
+
+    NonTrivialInt &operator=(const NonTrivialInt &other) {
+        value = other.value;
+        return *this;
+    }
+};
+
+void trivialCopyBenchmark() {
+    const int n = 1000000, rounds = 50;
+    long long checkSum = 0;
+
+    sjtu::vector<int> trivialVec;
+    sjtu::vector<NonTrivialInt> nonTrivialVec;
+    for (int i = 0; i < n; ++i) trivialVec.push_back(i), nonTrivialVec.push_back(i);
+
+    double trivialTime = benchTime([&] {
+        for (int r = 0; r < rounds; ++r) {
+            sjtu::vector<int> batch(trivialVec);
+            checkSum += batch[r];
+        }
+    });
+    double nonTrivialTime = benchTime([&] {
+        for (int r = 0; r < rounds; ++r) {
+            sjtu::vector<NonTrivialInt> batch(nonTrivialVec);
+            checkSum += batch[r].value;
+        }
+    });
+
+    std::cout << "[vector copy] n = " << n << ", copies = " << rounds << std::endl;
+    std::cout << "  trivially copyable (memcpy): " << trivialTime << " ms" << std::endl;
+    std::cout << "  non-trivial (per element):   " << nonTrivialTime << " ms" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+void smallVectorBenchmark() {
+    const int requests = 1000000, listLength = 12;
+    long long checkSum = 0;
+
+    // 每个请求构造一个短的临时列表
+    double heapTime = benchTime([&] {
+        for (int r = 0; r < requests; ++r) {
+            sjtu::vector<int> scratch;
+            for (int i = 0; i < listLength; ++i) scratch.push_back(r + i);
+            checkSum += scratch.back();
+        }
+    });
+    double inlineTime = benchTime([&] {
+        for (int r = 0; r < requests; ++r) {
+            sjtu::small_vector<int, 16> scratch;
+            for (int i = 0; i < listLength; ++i) scratch.push_back(r + i);
+            checkSum += scratch.back();
+        }
+    });
+
+    std::cout << "[small_vector] requests = " << requests << ", list length = " << listLength << std::endl;
+    std::cout << "  vector:                " << heapTime << " ms" << std::endl;
+    std::cout << "  small_vector<int, 16>: " << inlineTime << " ms" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+void dequeRandomAccessBenchmark() {
+    const int n = 10000000, queries = 1000000;
+    long long checkSum = 0;
+
+    sjtu::deque<int> dq;
+    double buildTime = benchTime([&] {
+        for (int i = 0; i < n / 2; ++i) dq.push_back(i), dq.push_front(-i);
+    });
+    unsigned int seed = 20231017;
+    double accessTime = benchTime([&] {
+        for (int q = 0; q < queries; ++q) {
+            seed = seed * 1103515245u + 12345u;
+            checkSum += dq[seed % n];
+        }
+    });
+
+    double iterateTime = benchTime([&] {
+        for (int x:dq) checkSum += x;
+    });
+    double blockTime = benchTime([&] {
+        dq.for_each_block([&](std::span<const int> block) {
+            long long sum = 0; // 块内为连续内存, 编译器可以向量化
+            for (int x:block) sum += x;
+            checkSum += sum;
+        });
+    });
+
+    std::cout << "[deque random access] n = " << n << ", queries = " << queries << std::endl;
+    std::cout << "  build (push_back + push_front): " << buildTime << " ms" << std::endl;
+    std::cout << "  operator[]:                     " << accessTime << " ms" << std::endl;
+    std::cout << "  range-for over all elements:    " << iterateTime << " ms" << std::endl;
+    std::cout << "  for_each_block over all blocks: " << blockTime << " ms" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+void dequeBlockSizeBenchmark() {
+    const int n = 1000000, updates = 20000, queries = 1000000;
+    const size_t blockSizes[] = {16, 64, 256, 1024, 4096};
+    long long checkSum = 0;
+
+    std::cout << "[deque block size] n = " << n << ", middle insert+erase = " << updates
+              << ", random reads = " << queries << " (default for int: "
+              << sjtu::deque<int>().block_capacity() << ")" << std::endl;
+    for (size_t blockSize:blockSizes) {
+        sjtu::deque<int> dq(sjtu::deque_block_size{blockSize});
+        for (int i = 0; i < n; ++i) dq.push_back(i);
+        unsigned int seed = 20231017;
+        double updateTime = benchTime([&] {
+            for (int i = 0; i < updates; ++i) {
+                seed = seed * 1103515245u + 12345u;
+                dq.insert(dq.begin() + int(seed % dq.size()), i);
+                seed = seed * 1103515245u + 12345u;
+                dq.erase(dq.begin() + int(seed % dq.size()));
+            }
+        });
+        double accessTime = benchTime([&] {
+            for (int q = 0; q < queries; ++q) {
+                seed = seed * 1103515245u + 12345u;
+                checkSum += dq[seed % n];
+            }
+        });
+        double iterateTime = benchTime([&] {
+            for (int x:dq) checkSum += x;
+        });
+        std::cout << "  block = " << blockSize << ": insert+erase " << updateTime << " ms, operator[] "
+                  << accessTime << " ms, iterate " << iterateTime << " ms" << std::endl;
+    }
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+void dequeQueueBenchmark() {
+    const int ops = 10000000, depth = 200;
+    long long checkSum = 0;
+
+    // 生产者/消费者队列: 长度在块边界附近上下波动
+    sjtu::deque<int> dq;
+    for (int i = 0; i < depth; ++i) dq.push_back(i);
+    double queueTime = benchTime([&] {
+        for (int i = 0; i < ops; ++i) {
+            dq.push_back(i);
+            if (i % 64 < 32) dq.push_back(i);
+            else checkSum += dq.front(), dq.pop_front();
+            checkSum += dq.front();
+            dq.pop_front();
+        }
+    });
+    auto stats = dq.pool_stats();
+
+    std::cout << "[deque queue] ops = " << ops << ", depth ~ " << depth << std::endl;
+    std::cout << "  push_back/pop_front: " << queueTime << " ms, block pool hit " << stats.hit << ", miss "
+              << stats.miss << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+// producerNum 个生产者与 consumerNum 个消费者通过队列传递 itemNum 个整数, 返回耗时 (ms)
+template<typename PushFunc, typename PopFunc>
+double handOffTime(int producerNum, int consumerNum, long long itemNum, PushFunc push, PopFunc pop,
+                   long long &checkSum) {
+    std::atomic<long long> consumed{0}, total{0};
+    return benchTime([&] {
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producerNum; ++p)
+            threads.emplace_back([&, p] {
+                for (long long i = p; i < itemNum; i += producerNum)
+                    while (!push(i)) std::this_thread::yield();
+            });
+        for (int c = 0; c < consumerNum; ++c)
+            threads.emplace_back([&] {
+                long long value, localSum = 0;
+                while (consumed.load(std::memory_order_relaxed) < itemNum) {
+                    if (pop(value)) localSum += value, consumed.fetch_add(1, std::memory_order_relaxed);
+                    else std::this_thread::yield();
+                }
+                total += localSum;
+            });
+        for (std::thread &t:threads) t.join();
+        checkSum += total.load();
+    });
+}
+
+void concurrentQueueBenchmark() {
+    const long long itemNum = 2000000;
+    const size_t queueCapacity = 1024;
+    long long checkSum = 0;
+
+    std::mutex lock;
+    sjtu::deque<long long> lockedDeque;
+    auto lockedPush = [&](long long v) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (lockedDeque.size() >= queueCapacity) return false;
+        lockedDeque.push_back(v);
+        return true;
+    };
+    auto lockedPop = [&](long long &v) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (lockedDeque.empty()) return false;
+        v = lockedDeque.front();
+        lockedDeque.pop_front();
+        return true;
+    };
+    double lockedSpsc = handOffTime(1, 1, itemNum, lockedPush, lockedPop, checkSum);
+    double lockedMpmc = handOffTime(2, 2, itemNum, lockedPush, lockedPop, checkSum);
+
+    sjtu::spsc_queue<long long> spsc(queueCapacity);
+    double spscTime = handOffTime(1, 1, itemNum, [&](long long v) { return spsc.push_back(v); },
+                                  [&](long long &v) { return spsc.pop_front(v); }, checkSum);
+
+    sjtu::mpmc_queue<long long> mpmc(queueCapacity);
+    auto mpmcPush = [&](long long v) { return mpmc.push_back(v); };
+    auto mpmcPop = [&](long long &v) { return mpmc.pop_front(v); };
+    double mpmcSingle = handOffTime(1, 1, itemNum, mpmcPush, mpmcPop, checkSum);
+    double mpmcMulti = handOffTime(2, 2, itemNum, mpmcPush, mpmcPop, checkSum);
+
+    std::cout << "[concurrent queue] items = " << itemNum << ", capacity = " << queueCapacity << std::endl;
+    std::cout << "  mutex + deque 1P1C: " << lockedSpsc << " ms, 2P2C: " << lockedMpmc << " ms" << std::endl;
+    std::cout << "  spsc_queue    1P1C: " << spscTime << " ms" << std::endl;
+    std::cout << "  mpmc_queue    1P1C: " << mpmcSingle << " ms, 2P2C: " << mpmcMulti << " ms" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+void parallelBenchmark() {
+    const int n = 1 << 23, rounds = 10;
+    size_t maxThread = std::thread::hardware_concurrency();
+    if (maxThread == 0) maxThread = 1;
+    long long checkSum = 0;
+
+    sjtu::vector<long long> vec;
+    sjtu::deque<long long> dq;
+    for (int i = 0; i < n; ++i) vec.push_back(i % 1000), dq.push_back(i % 1000);
+
+    std::cout << "[parallel] n = " << n << ", rounds = " << rounds << std::endl;
+    // 线程数依次为 1, 2, 4, ..., hardware_concurrency
+    for (size_t threadNum = 1;; threadNum = (threadNum * 2 < maxThread) ? threadNum * 2 : maxThread) {
+        sjtu::parallel::thread_pool pool(threadNum);
+        double vecReduce = benchTime([&] {
+            for (int r = 0; r < rounds; ++r) checkSum += sjtu::parallel::reduce(vec, 0LL, std::plus<>(), pool);
+        });
+        double vecScan = benchTime([&] {
+            for (int r = 0; r < rounds; ++r) {
+                sjtu::parallel::transform(vec.data(), vec.data() + vec.size(), vec.data(),
+                                          [](long long x) { return x % 1000; }, pool);
+                sjtu::parallel::inclusive_scan(vec, std::plus<>(), pool);
+            }
+            checkSum += vec.back();
+        });
+        double dqReduce = benchTime([&] {
+            for (int r = 0; r < rounds; ++r) checkSum += sjtu::parallel::reduce(dq, 0LL, std::plus<>(), pool);
+        });
+        double dqCount = benchTime([&] {
+            for (int r = 0; r < rounds; ++r)
+                checkSum += sjtu::parallel::count_if(dq, [](long long x) { return x % 3 == 0; }, pool);
+        });
+        std::cout << "  threads = " << threadNum << ": vector reduce " << vecReduce << " ms, vector scan "
+                  << vecScan << " ms, deque reduce " << dqReduce << " ms, deque count_if " << dqCount << " ms"
+                  << std::endl;
+        if (threadNum == maxThread) break;
+    }
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+long long serialFib(int n) { return n < 2 ? n : serialFib(n - 1) + serialFib(n - 2); }
+
+long long parallelFib(sjtu::parallel::work_stealing_pool &pool, int n) {
+    if (n < 20) return serialFib(n);
+    long long left, right;
+    sjtu::parallel::task_group group(pool);
+    group.spawn([&] { left = parallelFib(pool, n - 1); });
+    right = parallelFib(pool, n - 2);
+    group.wait();
+    return left + right;
+}
+
+long long parallelSum(sjtu::parallel::work_stealing_pool &pool, const long long *first, size_t n) {
+    if (n <= 16384) {
+        long long sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += first[i];
+        return sum;
+    }
+    long long left, right;
+    sjtu::parallel::task_group group(pool);
+    group.spawn([&] { left = parallelSum(pool, first, n / 2); });
+    right = parallelSum(pool, first + n / 2, n - n / 2);
+    group.wait();
+    return left + right;
+}
+
+void workStealingBenchmark() {
+    const int fibN = 38, n = 1 << 24, rounds = 10;
+    size_t maxThread = std::thread::hardware_concurrency();
+    if (maxThread == 0) maxThread = 1;
+    long long checkSum = 0;
+
+    sjtu::vector<long long> vec;
+    for (int i = 0; i < n; ++i) vec.push_back(i % 1000);
+
+    // 加速比均相对于单线程 (只有调用线程, 任务全部在本线程队列中执行)
+    double baseFib = 0, baseSum = 0;
+    std::cout << "[work stealing] fib(" << fibN << "), sum of " << n << " x " << rounds << std::endl;
+    for (size_t threadNum = 1;; threadNum = (threadNum * 2 < maxThread) ? threadNum * 2 : maxThread) {
+        sjtu::parallel::work_stealing_pool pool(threadNum);
+        double fibTime = benchTime([&] { checkSum += parallelFib(pool, fibN); });
+        double sumTime = benchTime([&] {
+            for (int r = 0; r < rounds; ++r) checkSum += parallelSum(pool, vec.data(), vec.size());
+        });
+        if (threadNum == 1) baseFib = fibTime, baseSum = sumTime;
+        std::cout << "  threads = " << threadNum << ": fib " << fibTime << " ms (x" << baseFib / fibTime
+                  << "), sum " << sumTime << " ms (x" << baseSum / sumTime << ")" << std::endl;
+        if (threadNum == maxThread) break;
+    }
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+void spillDequeBenchmark() {
+    const size_t memoryCap = size_t(32) << 20;
+    const long long n = (long long) (memoryCap * 10 / sizeof(long long)); // 数据量为内存上限的 10 倍
+    long long checkSum = 0;
+
+    auto queueTime = [&](sjtu::deque<long long> &dq) {
+        return benchTime([&] {
+            for (long long i = 0; i < n; ++i) dq.push_back(i);
+            while (!dq.empty()) checkSum += dq.front(), dq.pop_front();
+        });
+    };
+    sjtu::deque<long long> inMemory;
+    double memoryTime = queueTime(inMemory);
+    sjtu::spill_resource res(memoryCap);
+    double spillTime;
+    size_t fileBytes;
+    {
+        sjtu::deque<long long> spilled = sjtu::make_spill_deque<long long>(res);
+        spillTime = queueTime(spilled);
+        fileBytes = res.file_bytes();
+    }
+    std::cout << "[spill deque] push_back then pop_front " << (n * sizeof(long long) >> 20) << " MB, memory cap "
+              << (memoryCap >> 20) << " MB" << std::endl;
+    std::cout << "  in memory " << memoryTime << " ms, spilled " << spillTime << " ms (file " << (fileBytes >> 20)
+              << " MB, " << res.evicted_chunks() << " chunks written back)" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+// 统计分配次数的内存资源, 实际分配交给默认资源
+struct CountingResource : std::pmr::memory_resource {
+    size_t allocNum = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        ++allocNum;
+        return std::pmr::get_default_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        std::pmr::get_default_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+void mapBenchmark() {
+    const int n = 2000000;
+    long long checkSum = 0;
+    CountingResource counter;
+
+    sjtu::vector<int> keys;
+    unsigned int seed = 20231017;
+    for (int i = 0; i < n; ++i) seed = seed * 1103515245u + 12345u, keys.push_back(int(seed >> 1));
+
+    sjtu::map<int, int> mp(&counter);
+    double insertTime = benchTime([&] { for (int i = 0; i < n; ++i) mp[keys[i]] = i; });
+    double findTime = benchTime([&] {
+        for (int i = 0; i < n; ++i) checkSum += mp.find(keys[i])->second;
+    });
+    double eraseTime = benchTime([&] {
+        for (int i = 0; i < n; i += 2) {
+            auto it = mp.find(keys[i]);
+            if (it != mp.end()) mp.erase(it);
+        }
+    });
+    checkSum += mp.size();
+
+    // 窗口查询: 每次取键在 [lo, lo + window) 内的元素
+    const int windows = 10000, window = 1 << 16;
+    double rangeTime = benchTime([&] {
+        for (int q = 0; q < windows; ++q) {
+            int lo = keys[q] - window / 2;
+            mp.for_each_in_range(lo, lo + window, [&](const sjtu::pair<const int, int> &ele) { checkSum += ele.second; });
+        }
+    });
+
+    // 升序追加: 不带 hint 每次从根下降, 以 end() 为 hint 时只与最大元素比较一次
+    sjtu::map<int, int> plain, hinted;
+    double plainAppend = benchTime([&] { for (int i = 0; i < n; ++i) plain.insert(sjtu::pair<const int, int>(i, i)); });
+    double hintedAppend = benchTime([&] {
+        for (int i = 0; i < n; ++i) hinted.emplace_hint(hinted.cend(), i, i);
+    });
+    checkSum += plain.size() + hinted.size();
+
+    // 由有序快照重建: bulk_load 一次扫描确认有序后 O(n) 建树; 拷贝同样走这条路径
+    sjtu::vector<sjtu::pair<int, int>> snapshot;
+    for (int i = 0; i < n; ++i) snapshot.push_back(sjtu::pair<int, int>(i, i));
+    sjtu::map<int, int> loaded;
+    double bulkTime = benchTime([&] { loaded.bulk_load(snapshot.cbegin(), snapshot.cend()); });
+    double copyTime = benchTime([&] {
+        sjtu::map<int, int> copied(loaded);
+        checkSum += copied.size();
+    });
+    checkSum += loaded.size();
+
+    // 百分位查询: 开启 OrderStatistics 后 select 为 O(log n), 否则只能从 begin() 逐个前进
+    const int percentiles = 100;
+    sjtu::map<int, int, std::less<int>, true> ranked;
+    double rankedInsertTime = benchTime([&] { for (int i = 0; i < n; ++i) ranked[keys[i]] = i; });
+    double selectTime = benchTime([&] {
+        for (int q = 0; q < percentiles; ++q) checkSum += ranked.select(ranked.size() * q / percentiles)->second;
+    });
+    double walkTime = benchTime([&] {
+        for (int q = 0; q < percentiles; ++q) {
+            auto it = plain.begin();
+            for (size_t i = plain.size() * q / percentiles; i > 0; --i) ++it;
+            checkSum += it->second;
+        }
+    });
+    double rankTime = benchTime([&] { for (int i = 0; i < n; ++i) checkSum += ranked.rank(keys[i]); });
+
+    std::cout << "[map] n = " << n << std::endl;
+    std::cout << "  insert " << insertTime << " ms (" << counter.allocNum << " allocations), find " << findTime
+              << " ms, erase half " << eraseTime << " ms" << std::endl;
+    std::cout << "  " << windows << " window queries via for_each_in_range: " << rangeTime << " ms" << std::endl;
+    std::cout << "  ascending append: insert " << plainAppend << " ms, emplace_hint(end()) " << hintedAppend << " ms"
+              << std::endl;
+    std::cout << "  rebuild from sorted snapshot: bulk_load " << bulkTime << " ms, copy " << copyTime << " ms"
+              << std::endl;
+    std::cout << "  order statistics: insert " << rankedInsertTime << " ms, "
+              << percentiles << " percentiles via select " << selectTime << " ms (iterator walk over " << plain.size()
+              << " keys " << walkTime << " ms), " << n << " rank " << rankTime << " ms" << std::endl;
+    std::cout << "  (checksum " << checkSum << ")" << std::endl;
+}
+
+#endif
+
 int main() {
 
     int k = 1023;
@@ -268,5 +761,18 @@ int main() {
     qWrite(int(1 << 31), '\n');
     qWrite(short(1 << 15), '\n');
     // std::cout << int(1<<30) << std::endl << int(1<<31) << std::endl;
+#ifdef PTL_BENCHMARK
+    vectorBenchmark();
+    smallVectorBenchmark();
+    trivialCopyBenchmark();
+    parallelBenchmark();
+    dequeRandomAccessBenchmark();
+    dequeBlockSizeBenchmark();
+    dequeQueueBenchmark();
+    concurrentQueueBenchmark();
+    workStealingBenchmark();
+    spillDequeBenchmark();
+    mapBenchmark();
+#endif
     return 0;
 }
@@ -6,14 +6,30 @@
 
 #include <functional> // std::less<T>
 #include <cstddef>
+#include <iterator> // std::forward_iterator, std::next
+#include <memory_resource>
+#include <new> // placement new, std::launder
+#include <tuple> // std::forward_as_tuple
+#include <type_traits> // std::conditional_t
 #include "utility.hpp" // pair
 #include "exceptions.hpp"
 
 #include <iostream> // print debug info
 
+/**
+ * 结点内直接存放 pair<const Key, Value>, 插入只需取一个结点
+ * 结点从 map 自有的 slab 中切分: slab 容量从 MAP_SLAB_MIN_NODES 起倍增至 MAP_SLAB_MAX_NODES,
+ *   删除的结点进入空闲链表复用, slab 在 clear / 析构时整体归还给内存资源
+ *   拷贝与有序批量构造 (bulk_load) 一次分配恰好容纳全部元素的 slab, 在 O(n) 内直接建出平衡树
+ * OrderStatistics 为 true 时每个结点额外记录子树大小, 提供 O(log n) 的 select / rank;
+ *   为 false (默认) 时该字段以空基类的形式存在, 不占空间也不产生任何维护代码
+ */
+#define MAP_SLAB_MIN_NODES 16
+#define MAP_SLAB_MAX_NODES 4096
+
 namespace sjtu {
 
-    template<class Key, class Value, class Compare = std::less<Key> >
+    template<class Key, class Value, class Compare = std::less<Key>, bool OrderStatistics = false>
     class map {
 
 #pragma region DECLARATION
@@ -25,25 +41,49 @@ namespace sjtu {
             RED, BLACK
         };
 
-        struct Node {
-            value_type *element;
+        std::pmr::memory_resource *memResource; // slab 与哨兵结点由此分配
+
+        struct NoSubtreeSize {
+        };
+
+        struct WithSubtreeSize {
+            size_t subtreeSize = 0; // 哨兵结点恒为 0
+        };
+
+        struct Node : std::conditional_t<OrderStatistics, WithSubtreeSize, NoSubtreeSize> {
             nodeColorENUM color;
             Node *lChild, *rChild, *parent;
+            alignas(value_type) unsigned char storage[sizeof(value_type)]; // 哨兵结点不构造元素
 
-            Node(value_type *ele = nullptr, nodeColorENUM col = BLACK,
-                 Node *lc = nullptr, Node *rc = nullptr, Node *par = nullptr)
-                    : element(ele), color(col), lChild(lc), rChild(rc), parent(par) {}
+            Node(nodeColorENUM col = BLACK, Node *lc = nullptr, Node *rc = nullptr, Node *par = nullptr)
+                    : color(col), lChild(lc), rChild(rc), parent(par) {}
 
-            Node(const Node &other) : element(new value_type(*other.element)), color(other.color),
-                                      lChild(nullptr), rChild(nullptr), parent(nullptr) {}
+            value_type *element() { return std::launder(reinterpret_cast<value_type *>(storage)); }
 
-            ~Node() { delete element; }
-        } *const NilPtr, *beginNodePtr;//, *&rootPtr;
+            const value_type *element() const {
+                return std::launder(reinterpret_cast<const value_type *>(storage));
+            }
+
+            // 元素由 map 负责构造与析构 (见 _newNode / _deleteNode)
+        } *const NilPtr, *beginNodePtr, *lastNodePtr;//, *&rootPtr;
         // *& 为引用, 不能改变引用的对象, 操作该值即操作引用值
 
         Compare compare;
         size_t elementNum;
 
+        struct NodeSlab {
+            NodeSlab *nxtSlab;
+            size_t nodeNum;
+        };
+
+        static constexpr size_t slabHeaderBytes =
+                (sizeof(NodeSlab) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+        static constexpr size_t slabAlign = (alignof(Node) > alignof(NodeSlab)) ? alignof(Node) : alignof(NodeSlab);
+
+        NodeSlab *slabList;
+        Node *freeNodes; // 空闲结点以 lChild 串成链表
+        size_t nextSlabNodeNum;
+
         template<typename _T>
         void _swap(_T &_x, _T &_y) {
             _T _t(_x);
@@ -58,6 +98,58 @@ namespace sjtu {
 #pragma region TREEOPERATION
     private:
 
+        // 分配容纳 nodeNum 个结点的 slab, 返回其中按地址排列的结点 (尚未放入空闲链表)
+        Node *_newSlab(size_t nodeNum) {
+            void *mem = memResource->allocate(slabHeaderBytes + sizeof(Node) * nodeNum, slabAlign);
+            auto *slab = ::new(mem) NodeSlab{slabList, nodeNum};
+            slabList = slab;
+            auto *nodes = reinterpret_cast<Node *>(static_cast<unsigned char *>(mem) + slabHeaderBytes);
+            for (size_t i = 0; i < nodeNum; ++i) ::new(static_cast<void *>(nodes + i)) Node();
+            return nodes;
+        }
+
+        // 低地址的结点排在链表前面, 先被取用
+        void _pushFreeNodes(Node *nodes, size_t nodeNum) {
+            for (size_t i = nodeNum; i-- > 0;) {
+                nodes[i].lChild = freeNodes;
+                freeNodes = nodes + i;
+            }
+        }
+
+        void allocateSlab() {
+            _pushFreeNodes(_newSlab(nextSlabNodeNum), nextSlabNodeNum);
+            if (nextSlabNodeNum < MAP_SLAB_MAX_NODES) nextSlabNodeNum <<= 1;
+        }
+
+        // 归还全部 slab, 调用前须已析构其中的所有元素
+        void releaseSlabs() {
+            while (slabList != nullptr) {
+                NodeSlab *nxt = slabList->nxtSlab;
+                memResource->deallocate(slabList, slabHeaderBytes + sizeof(Node) * slabList->nodeNum, slabAlign);
+                slabList = nxt;
+            }
+            freeNodes = nullptr;
+            nextSlabNodeNum = MAP_SLAB_MIN_NODES;
+        }
+
+        template<typename... Args>
+        Node *_newNode(nodeColorENUM col, Args &&... args) {
+            if (freeNodes == nullptr) allocateSlab();
+            Node *p = freeNodes;
+            ::new(static_cast<void *>(p->storage)) value_type(std::forward<Args>(args)...);
+            freeNodes = p->lChild;
+            p->color = col;
+            p->lChild = p->rChild = p->parent = NilPtr;
+            if constexpr (OrderStatistics) p->subtreeSize = 1;
+            return p;
+        }
+
+        void _deleteNode(Node *p) {
+            p->element()->~value_type();
+            p->lChild = freeNodes;
+            freeNodes = p;
+        }
+
         void lRotate(Node *x) {
             Node *y = x->parent;
             if (x->lChild != NilPtr) x->lChild->parent = y;
@@ -67,6 +159,10 @@ namespace sjtu {
             x->parent = y->parent;
             y->parent = x;
             x->lChild = y;
+            if constexpr (OrderStatistics) {
+                x->subtreeSize = y->subtreeSize;
+                y->subtreeSize = y->lChild->subtreeSize + y->rChild->subtreeSize + 1;
+            }
         }
 
         void rRotate(Node *x) {
@@ -78,6 +174,10 @@ namespace sjtu {
             x->parent = y->parent;
             y->parent = x;
             x->rChild = y;
+            if constexpr (OrderStatistics) {
+                x->subtreeSize = y->subtreeSize;
+                y->subtreeSize = y->lChild->subtreeSize + y->rChild->subtreeSize + 1;
+            }
         }
 
         void _transplant(Node *const x, Node *const y) { // replace x with y
@@ -185,45 +285,154 @@ namespace sjtu {
             return p;
         }
 
+        // 第一个键不小于 key 的结点, 不存在时为 NilPtr
+        Node *_lowerBound(const Key &key) const {
+            Node *p = ROOT_PTR, *ret = NilPtr;
+            while (p != NilPtr) {
+                if (compare(p->element()->first, key)) p = p->rChild;
+                else ret = p, p = p->lChild;
+            }
+            return ret;
+        }
+
+        // 第一个键大于 key 的结点, 不存在时为 NilPtr
+        Node *_upperBound(const Key &key) const {
+            Node *p = ROOT_PTR, *ret = NilPtr;
+            while (p != NilPtr) {
+                if (compare(key, p->element()->first)) ret = p, p = p->lChild;
+                else p = p->rChild;
+            }
+            return ret;
+        }
+
         Node *_searchKey(const Key &key) const {
             Node *p = ROOT_PTR;
             while (p != NilPtr) {
-                bool b1 = compare(key, p->element->first),
-                        b2 = compare(p->element->first, key);
+                bool b1 = compare(key, p->element()->first),
+                        b2 = compare(p->element()->first, key);
                 if (b1 || b2) p = b1 ? p->lChild : p->rChild;
                 else break;
             }
             return p;
         }
 
-        Node *_insertEle(value_type *elePtr) {
-            Node *newNode = new Node(elePtr, RED, NilPtr, NilPtr);
-            Node *p = ROOT_PTR, *fa = NilPtr;
+        // 自根向下查找 key: 找到时返回该结点, 否则返回 NilPtr, 并由 fa / toLeft 给出新结点挂接的位置
+        Node *_descend(const Key &key, Node *&fa, bool &toLeft) const {
+            Node *p = ROOT_PTR;
+            fa = NilPtr, toLeft = true;
             while (p != NilPtr) {
-                fa = p;
-                p = compare(elePtr->first, p->element->first)
-                    ? p->lChild : p->rChild;
+                if (compare(key, p->element()->first)) fa = p, toLeft = true, p = p->lChild;
+                else if (compare(p->element()->first, key)) fa = p, toLeft = false, p = p->rChild;
+                else return p;
             }
-            if (fa == NilPtr || compare(elePtr->first, fa->element->first))
-                fa->lChild = newNode;
+            return NilPtr;
+        }
+
+        /**
+         * 与 _descend 相同, 但先检查 key 是否恰好落在 hint 与其前驱 (或 hint 与其后继) 之间,
+         *   是则直接挂在两者之一的空孩子上; hint 为 end() 时与最大元素比较, 因此升序追加为 O(1)
+         * hint 为 nullptr 或不合适时退化为一次完整的下降
+         */
+        Node *_locate(Node *hint, const Key &key, Node *&fa, bool &toLeft) const {
+            if (hint == nullptr || elementNum == 0) return _descend(key, fa, toLeft);
+            if (hint == NilPtr) {
+                if (compare(lastNodePtr->element()->first, key)) {
+                    fa = lastNodePtr, toLeft = false;
+                    return NilPtr;
+                }
+            } else if (compare(key, hint->element()->first)) {
+                Node *pre = (hint == beginNodePtr) ? NilPtr : findPre(hint);
+                if (pre == NilPtr || compare(pre->element()->first, key)) {
+                    // hint 有左孩子时 pre 是其左子树的最大结点, 没有右孩子
+                    if (hint->lChild == NilPtr) fa = hint, toLeft = true;
+                    else fa = pre, toLeft = false;
+                    return NilPtr;
+                }
+            } else if (compare(hint->element()->first, key)) {
+                Node *suc = (hint == lastNodePtr) ? NilPtr : findSuc(hint);
+                if (suc == NilPtr || compare(key, suc->element()->first)) {
+                    if (hint->rChild == NilPtr) fa = hint, toLeft = false;
+                    else fa = suc, toLeft = true;
+                    return NilPtr;
+                }
+            } else return hint;
+            return _descend(key, fa, toLeft);
+        }
+
+        // 将新结点挂在 _descend / _locate 给出的位置并重新平衡
+        Node *_linkNode(Node *newNode, Node *fa, bool toLeft) {
+            bool isMin = (fa == NilPtr || (toLeft && fa == beginNodePtr));
+            bool isMax = (fa == NilPtr || (!toLeft && fa == lastNodePtr));
+            if (toLeft) fa->lChild = newNode;
             else fa->rChild = newNode;
             newNode->parent = fa;
+            if constexpr (OrderStatistics)
+                for (Node *q = fa; q != NilPtr; q = q->parent) ++q->subtreeSize;
             _insertFixup(newNode);
 
             NilPtr->parent = NilPtr; // NilPtr->parent 功能存疑
 
             ++elementNum;
-            if (beginNodePtr != NilPtr) {
-                if (compare(elePtr->first, beginNodePtr->element->first))
-                    beginNodePtr = newNode;
+            if (isMin) beginNodePtr = newNode;
+            if (isMax) lastNodePtr = newNode;
+            return newNode;
+        }
+
+        // key 不存在时以 (key, args...) 原地构造新元素, 返回该键所在结点与是否插入
+        template<typename K, typename... Args>
+        pair<Node *, bool> _tryEmplace(Node *hint, K &&key, Args &&... args) {
+            Node *fa;
+            bool toLeft;
+            Node *p = _locate(hint, key, fa, toLeft);
+            if (p != NilPtr) return pair<Node *, bool>(p, false);
+            p = _newNode(RED, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+            return pair<Node *, bool>(_linkNode(p, fa, toLeft), true);
+        }
+
+        // 先构造元素再查找 (键只能从元素中取得), 键已存在时销毁新元素
+        template<typename... Args>
+        pair<Node *, bool> _emplace(Node *hint, Args &&... args) {
+            Node *newNode = _newNode(RED, std::forward<Args>(args)...);
+            Node *fa;
+            bool toLeft;
+            Node *p = _locate(hint, newNode->element()->first, fa, toLeft);
+            if (p != NilPtr) {
+                _deleteNode(newNode);
+                return pair<Node *, bool>(p, false);
             }
-            else beginNodePtr = newNode;
+            return pair<Node *, bool>(_linkNode(newNode, fa, toLeft), true);
+        }
 
-            return newNode;
+        // 插入已有的 value_type: 先按键查找, 键不存在时才拷贝 (移动) 构造元素
+        template<typename V>
+        pair<Node *, bool> _insertValue(Node *hint, V &&ele) {
+            Node *fa;
+            bool toLeft;
+            Node *p = _locate(hint, ele.first, fa, toLeft);
+            if (p != NilPtr) return pair<Node *, bool>(p, false);
+            return pair<Node *, bool>(_linkNode(_newNode(RED, std::forward<V>(ele)), fa, toLeft), true);
+        }
+
+        // 中序第 k 个 (从 0 起) 结点, 调用前须保证 k < elementNum
+        Node *_select(size_t k) const requires OrderStatistics {
+            Node *p = ROOT_PTR;
+            while (true) {
+                size_t leftNum = p->lChild->subtreeSize;
+                if (k < leftNum) p = p->lChild;
+                else if (k == leftNum) return p;
+                else k -= leftNum + 1, p = p->rChild;
+            }
         }
 
         void _eraseNode(Node *p) {
             if (p == beginNodePtr) beginNodePtr = findSuc(beginNodePtr);
+            if (p == lastNodePtr) lastNodePtr = (elementNum == 1) ? NilPtr : findPre(lastNodePtr);
+            if constexpr (OrderStatistics) {
+                // 实际摘下的位置是 p 或其后继所在处, 该位置以上的祖先子树各少一个结点
+                Node *removed = (p->lChild != NilPtr && p->rChild != NilPtr) ? findMin(p->rChild) : p;
+                for (Node *q = removed->parent; q != NilPtr; q = q->parent) --q->subtreeSize;
+            }
             nodeColorENUM clr = p->color;
             Node *replaceNodePtr;
             if (p->lChild == NilPtr) replaceNodePtr = p->rChild, _transplant(p, replaceNodePtr);
@@ -242,8 +451,9 @@ namespace sjtu {
                 nxtNodePtr->color = p->color;
                 nxtNodePtr->lChild = p->lChild;
                 nxtNodePtr->lChild->parent = nxtNodePtr;
+                if constexpr (OrderStatistics) nxtNodePtr->subtreeSize = p->subtreeSize;
             }
-            delete p;
+            _deleteNode(p);
             if (clr == BLACK) _eraseFixup(replaceNodePtr);
 
             NilPtr->parent = NilPtr; // NilPtr->parent 功能存疑
@@ -251,30 +461,60 @@ namespace sjtu {
             --elementNum;
         }
 
-        void copyDfs(Node *parentNode, Node *&thisNode, const Node *const otherNode, const Node *const otherNil) {
-            if (otherNode == otherNil) thisNode = NilPtr;
-            else {
-                thisNode = new Node(*otherNode);
-                thisNode->parent = parentNode;
-                copyDfs(thisNode, thisNode->lChild, otherNode->lChild, otherNil);
-                copyDfs(thisNode, thisNode->rChild, otherNode->rChild, otherNil);
+        /**
+         * 由 first 起按键严格升序的 n 个元素建树, 调用前树须为空
+         * 元素依次构造在同一块 slab 中, 第 i 个结点即中序第 i 个; 再用显式栈按区间中点连接:
+         *   左右子树大小至多差 1, 因此除最深一层外各层都是满的, 把最深一层 (不满时) 染红即满足红黑性质
+         */
+        template<typename It>
+        void _buildSorted(It first, size_t n) {
+            if (n == 0) return;
+            Node *nodes = _newSlab(n);
+            size_t builtNum = 0;
+            try {
+                for (; builtNum < n; ++builtNum, ++first)
+                    ::new(static_cast<void *>(nodes[builtNum].storage)) value_type(*first);
+            } catch (...) {
+                while (builtNum > 0) nodes[--builtNum].element()->~value_type();
+                _pushFreeNodes(nodes, n);
+                throw;
             }
-        }
 
-        /*void _copy(const Node *const otherRoot, const Node *const otherNil) {
-            if (otherRoot == otherNil) {
-                rootPtr = NilPtr;
-                return;
+            size_t redDepth = 0; // floor(log2(n + 1)), 即第一层不满的深度
+            while ((size_t(2) << redDepth) <= n + 1) ++redDepth;
+
+            struct Range {
+                size_t lo, hi, depth;
+                Node *parent;
+                bool toLeft;
+            } stack[2 * 8 * sizeof(size_t)]; // 每层至多压入一个右区间, 树高不超过 size_t 的位数
+            size_t top = 0;
+            stack[top++] = Range{0, n, 0, NilPtr, true}; // 根即 NilPtr->lChild
+            while (top > 0) {
+                Range r = stack[--top];
+                size_t mid = r.lo + (r.hi - r.lo) / 2;
+                Node *p = nodes + mid;
+                p->color = (r.depth == redDepth) ? RED : BLACK;
+                p->lChild = p->rChild = NilPtr;
+                p->parent = r.parent;
+                if (r.toLeft) r.parent->lChild = p;
+                else r.parent->rChild = p;
+                if constexpr (OrderStatistics) p->subtreeSize = r.hi - r.lo;
+                if (mid + 1 < r.hi) stack[top++] = Range{mid + 1, r.hi, r.depth + 1, p, false};
+                if (r.lo < mid) stack[top++] = Range{r.lo, mid, r.depth + 1, p, true};
             }
-            rootPtr = new Node(*otherRoot);
-            _copyDfs(rootPtr->lChild, otherRoot->lChild, otherNil);
-            _copyDfs(rootPtr->rChild, otherRoot->rChild);
-        }*/
 
-        void _destroy(const Node *p) {
+            NilPtr->parent = NilPtr;
+            elementNum = n;
+            beginNodePtr = nodes;
+            lastNodePtr = nodes + n - 1;
+        }
+
+        // 只析构元素, 结点随 releaseSlabs 一并归还
+        void _destroy(Node *p) {
             if (p == NilPtr)return;
             _destroy(p->lChild), _destroy(p->rChild);
-            delete p;
+            p->element()->~value_type();
         }
 
 #pragma endregion TREEOPERATION
@@ -324,7 +564,7 @@ namespace sjtu {
                 return *this;
             }
 
-            value_type &operator*() const { return *(nodePtr->element); }
+            value_type &operator*() const { return *(nodePtr->element()); }
 
             bool operator==(const iterator &rhs) const {
                 return (subject == rhs.subject && nodePtr == rhs.nodePtr);
@@ -342,7 +582,7 @@ namespace sjtu {
                 return (subject != rhs.subject || nodePtr != rhs.nodePtr);
             }
 
-            value_type *operator->() const noexcept { return nodePtr->element; }
+            value_type *operator->() const noexcept { return nodePtr->element(); }
         };
 
         class const_iterator {
@@ -386,7 +626,7 @@ namespace sjtu {
                 return *this;
             }
 
-            const value_type &operator*() const { return *(nodePtr->element); }
+            const value_type &operator*() const { return *(nodePtr->element()); }
 
             bool operator==(const iterator &rhs) const {
                 return (subject == rhs.subject && nodePtr == rhs.nodePtr);
@@ -404,51 +644,65 @@ namespace sjtu {
                 return (subject != rhs.subject || nodePtr != rhs.nodePtr);
             }
 
-            const value_type *operator->() const noexcept { return nodePtr->element; }
+            const value_type *operator->() const noexcept { return nodePtr->element(); }
         };
 
+    private:
+        Node *_hintNode(const const_iterator &hint) const {
+            if (hint.subject != this) throw invalid_iterator();
+            return hint.nodePtr;
+        }
+
 #pragma endregion ITERATOR
 
 #pragma region BASICFUNCTION
     public:
-        map() : elementNum(0), NilPtr(new Node()), beginNodePtr(NilPtr) {
+        map() : map(std::pmr::get_default_resource()) {}
+
+        // 全部内存由 res 分配, 如传入 monotonic_buffer_resource 可整体丢弃
+        explicit map(std::pmr::memory_resource *res)
+                : memResource(res), NilPtr(newObject<Node>(res)), beginNodePtr(NilPtr), lastNodePtr(NilPtr),
+                  elementNum(0),
+                  slabList(nullptr), freeNodes(nullptr), nextSlabNodeNum(MAP_SLAB_MIN_NODES) {
             NilPtr->parent = NilPtr;
             NilPtr->lChild = NilPtr; // rootPtr
             NilPtr->rChild = NilPtr;
         }
 
-        map(const map &other) : map() {
-            copyDfs(NilPtr, ROOT_PTR, other.NilPtr->lChild, other.NilPtr);
-            elementNum = other.elementNum;
-            beginNodePtr = findMin(ROOT_PTR);
+        // 与 std::pmr 容器一致, 拷贝构造使用默认内存资源
+        map(const map &other) : map(other, std::pmr::get_default_resource()) {}
+
+        // 按中序遍历 other 并直接建树, 不递归, 也不保留 other 的形状
+        map(const map &other, std::pmr::memory_resource *res) : map(res) {
+            _buildSorted(other.cbegin(), other.elementNum);
+        }
+
+        /**
+         * 由 [first, last) 中的 pair 构造, 区间按键严格升序时 O(n) 建树 (见 bulk_load)
+         * 否则逐个以 end() 为 hint 插入, 重复的键只保留第一个
+         */
+        template<std::forward_iterator It>
+        map(It first, It last, std::pmr::memory_resource *res = std::pmr::get_default_resource()) : map(res) {
+            bulk_load(first, last);
         }
 
         map &operator=(const map &other) {
             if (&other == this) return *this;
-            _destroy(ROOT_PTR);
-            NilPtr->parent = NilPtr;
-            NilPtr->lChild = NilPtr; // rootPtr
-            NilPtr->rChild = NilPtr;
-
-            copyDfs(NilPtr, ROOT_PTR, other.NilPtr->lChild, other.NilPtr);
-            elementNum = other.elementNum;
-            beginNodePtr = findMin(ROOT_PTR);
+            clear();
+            _buildSorted(other.cbegin(), other.elementNum);
             return *this;
         }
 
         ~map() {
             _destroy(ROOT_PTR);
-            delete NilPtr;
+            releaseSlabs();
+            deleteObject(memResource, NilPtr);
         }
 
-        Value &operator[](const Key &key) {
-            Node *ptr = _searchKey(key);
-            if (ptr == NilPtr) {
-                auto *tmpEle = new value_type(key, Value());
-                ptr = _insertEle(tmpEle);
-            }
-            return (ptr->element->second);
-        }
+        // 只下降一次, 键不存在时原地值初始化 Value
+        Value &operator[](const Key &key) { return _tryEmplace(nullptr, key).first->element()->second; }
+
+        Value &operator[](Key &&key) { return _tryEmplace(nullptr, std::move(key)).first->element()->second; }
 
         const Value &operator[](const Key &key) const { return at(key); }
 
@@ -459,13 +713,13 @@ namespace sjtu {
         Value &at(const Key &key) {
             Node *ptr = _searchKey(key);
             if (ptr == NilPtr) throw index_out_of_bound();
-            return (ptr->element->second);
+            return (ptr->element()->second);
         }
 
         const Value &at(const Key &key) const {
             Node *ptr = _searchKey(key);
             if (ptr == NilPtr) throw index_out_of_bound();
-            return (ptr->element->second);
+            return (ptr->element()->second);
         }
 
         iterator begin() { return iterator(this, beginNodePtr); }
@@ -480,23 +734,104 @@ namespace sjtu {
 
         size_t size() const { return elementNum; }
 
+        std::pmr::memory_resource *resource() const { return memResource; }
+
         void clear() {
             elementNum = 0;
             _destroy(ROOT_PTR);
+            releaseSlabs();
             NilPtr->parent = NilPtr;
             NilPtr->lChild = NilPtr; // rootPtr
             NilPtr->rChild = NilPtr;
-            beginNodePtr = NilPtr;
+            beginNodePtr = lastNodePtr = NilPtr;
+        }
+
+        /**
+         * 以 [first, last) 替换全部元素: 先扫描一遍确认按键严格升序, 是则 O(n) 建出平衡树,
+         *   全部结点分配在一块连续内存中且无需任何旋转; 否则退化为逐个以 end() 为 hint 插入
+         */
+        template<std::forward_iterator It>
+        void bulk_load(It first, It last) {
+            clear();
+            if (first == last) return;
+            size_t n = 1;
+            bool isSorted = true;
+            for (It pre = first, cur = std::next(first); cur != last; pre = cur, ++cur, ++n)
+                if (isSorted && !compare((*pre).first, (*cur).first)) isSorted = false;
+            if (isSorted) _buildSorted(first, n);
+            else for (; first != last; ++first) emplace_hint(cend(), *first);
         }
 
         pair<iterator, bool> insert(const value_type &ele) {
-            Node *nodePtr = _searchKey(ele.first);
-            if (nodePtr == NilPtr) {
-                auto *tmpEle = new value_type(ele);
-                nodePtr = _insertEle(tmpEle);
-                return pair<iterator, bool>(iterator(this, nodePtr), true);
-            }
-            else return pair<iterator, bool>(iterator(this, nodePtr), false);
+            pair<Node *, bool> ret = _insertValue(nullptr, ele);
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
+        }
+
+        pair<iterator, bool> insert(value_type &&ele) {
+            pair<Node *, bool> ret = _insertValue(nullptr, std::move(ele));
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
+        }
+
+        /**
+         * hint 为插入位置的建议: 新键恰好应在 hint 之前或之后 (包括 hint == end() 时大于全部键) 时均摊 O(1),
+         *   否则与不带 hint 的版本相同; 返回键所在位置
+         */
+        iterator insert(const_iterator hint, const value_type &ele) {
+            return iterator(this, _insertValue(_hintNode(hint), ele).first);
+        }
+
+        iterator insert(const_iterator hint, value_type &&ele) {
+            return iterator(this, _insertValue(_hintNode(hint), std::move(ele)).first);
+        }
+
+        // 以 args 原地构造元素; 键已存在时新元素被销毁
+        template<typename... Args>
+        pair<iterator, bool> emplace(Args &&... args) {
+            pair<Node *, bool> ret = _emplace(nullptr, std::forward<Args>(args)...);
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
+        }
+
+        template<typename... Args>
+        iterator emplace_hint(const_iterator hint, Args &&... args) {
+            return iterator(this, _emplace(_hintNode(hint), std::forward<Args>(args)...).first);
+        }
+
+        // 键不存在时才以 (key, Value(args...)) 构造元素, 键已存在时不会移动 key 与 args
+        template<typename... Args>
+        pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+            pair<Node *, bool> ret = _tryEmplace(nullptr, key, std::forward<Args>(args)...);
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
+        }
+
+        template<typename... Args>
+        pair<iterator, bool> try_emplace(Key &&key, Args &&... args) {
+            pair<Node *, bool> ret = _tryEmplace(nullptr, std::move(key), std::forward<Args>(args)...);
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
+        }
+
+        template<typename... Args>
+        iterator try_emplace(const_iterator hint, const Key &key, Args &&... args) {
+            return iterator(this, _tryEmplace(_hintNode(hint), key, std::forward<Args>(args)...).first);
+        }
+
+        template<typename... Args>
+        iterator try_emplace(const_iterator hint, Key &&key, Args &&... args) {
+            return iterator(this, _tryEmplace(_hintNode(hint), std::move(key), std::forward<Args>(args)...).first);
+        }
+
+        // 键存在时赋值, 否则插入; 返回值的 second 表示是否插入
+        template<typename M>
+        pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+            pair<Node *, bool> ret = _tryEmplace(nullptr, key, std::forward<M>(obj));
+            if (!ret.second) ret.first->element()->second = std::forward<M>(obj);
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
+        }
+
+        template<typename M>
+        pair<iterator, bool> insert_or_assign(Key &&key, M &&obj) {
+            pair<Node *, bool> ret = _tryEmplace(nullptr, std::move(key), std::forward<M>(obj));
+            if (!ret.second) ret.first->element()->second = std::forward<M>(obj);
+            return pair<iterator, bool>(iterator(this, ret.first), ret.second);
         }
 
         void erase(iterator pos) {
@@ -504,12 +839,93 @@ namespace sjtu {
             _eraseNode(pos.nodePtr);
         }
 
+        // 删除 [first, last), 返回 last; 删除全部元素时等同于 clear()
+        iterator erase(iterator first, iterator last) {
+            if (first.subject != this || last.subject != this) throw invalid_iterator();
+            if (first.nodePtr == beginNodePtr && last.nodePtr == NilPtr) {
+                clear();
+                return end();
+            }
+            Node *p = first.nodePtr;
+            while (p != last.nodePtr) {
+                if (p == NilPtr) throw invalid_iterator(); // first 在 last 之后
+                Node *nxt = findSuc(p);
+                _eraseNode(p); // 删除只调整指针, 不搬移元素, 因此 nxt 仍然有效
+                p = nxt;
+            }
+            return last;
+        }
+
+        // 返回删除的元素个数 (0 或 1)
+        size_t erase(const Key &key) {
+            Node *p = _searchKey(key);
+            if (p == NilPtr) return 0;
+            _eraseNode(p);
+            return 1;
+        }
+
         size_t count(const Key &key) const { return ((_searchKey(key) == NilPtr) ? 0 : 1); }
 
         iterator find(const Key &key) { return iterator(this, _searchKey(key)); } // NilPtr is end()
 
         const_iterator find(const Key &key) const { return const_iterator(this, _searchKey(key)); }
 
+        iterator lower_bound(const Key &key) { return iterator(this, _lowerBound(key)); }
+
+        const_iterator lower_bound(const Key &key) const { return const_iterator(this, _lowerBound(key)); }
+
+        iterator upper_bound(const Key &key) { return iterator(this, _upperBound(key)); }
+
+        const_iterator upper_bound(const Key &key) const { return const_iterator(this, _upperBound(key)); }
+
+        pair<iterator, iterator> equal_range(const Key &key) {
+            return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+        }
+
+        pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+            return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+        }
+
+        /**
+         * 按键升序对 [lo, hi) 内的每个元素调用 func(value_type &)
+         * 只下降一次找到起点, 之后沿中序后继前进, 代价为 O(log n + 区间内元素数)
+         * func 中不应增删本 map 的元素
+         */
+        template<typename Func>
+        void for_each_in_range(const Key &lo, const Key &hi, Func &&func) {
+            for (Node *p = _lowerBound(lo); p != NilPtr && compare(p->element()->first, hi); p = findSuc(p))
+                func(*p->element());
+        }
+
+        template<typename Func>
+        void for_each_in_range(const Key &lo, const Key &hi, Func &&func) const {
+            for (Node *p = _lowerBound(lo); p != NilPtr && compare(p->element()->first, hi); p = findSuc(p))
+                func(*static_cast<const value_type *>(p->element()));
+        }
+
+        // 以下两个函数仅在 OrderStatistics 为 true 时可用
+        // 升序第 k 个 (从 0 起) 元素, k >= size() 时抛出 index_out_of_bound
+        iterator select(size_t k) requires OrderStatistics {
+            if (k >= elementNum) throw index_out_of_bound();
+            return iterator(this, _select(k));
+        }
+
+        const_iterator select(size_t k) const requires OrderStatistics {
+            if (k >= elementNum) throw index_out_of_bound();
+            return const_iterator(this, _select(k));
+        }
+
+        // 严格小于 key 的元素个数, 即 lower_bound(key) 在升序中的下标
+        size_t rank(const Key &key) const requires OrderStatistics {
+            size_t ret = 0;
+            Node *p = ROOT_PTR;
+            while (p != NilPtr) {
+                if (compare(p->element()->first, key)) ret += p->lChild->subtreeSize + 1, p = p->rChild;
+                else p = p->lChild;
+            }
+            return ret;
+        }
+
 #pragma endregion USERFUNCTION
 
 #pragma region DEBUG
@@ -518,7 +934,7 @@ namespace sjtu {
             if (p == NilPtr) std::cout << "Nil:            " << path << std::endl;
             else
                 std::cout << p << " " << (p->color == BLACK ? "Black: " : "Red:   ")
-                          << path << " = " << p->element->first << std::endl;
+                          << path << " = " << p->element()->first << std::endl;
             if (fa == p || p == NilPtr)return;
             printDfs(p, p->lChild, path + "-L");
             printDfs(p, p->rChild, path + "-R");
@@ -0,0 +1,387 @@
+#ifndef SJTU_PARALLEL_HPP
+#define SJTU_PARALLEL_HPP
+
+#include "vector.hpp"
+#include "deque.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * 基于线程池的并行算法: for_each / transform / reduce / inclusive_scan / count_if
+ * 支持原生数组 (指针区间), sjtu::vector 与 sjtu::deque (按块划分任务)
+ * 元素数少于 PARALLEL_SERIAL_THRESHOLD 时直接在调用线程上串行执行
+ * reduce / inclusive_scan 的 op 需满足结合律 (不要求交换律, 各段结果按顺序合并)
+ */
+#define PARALLEL_SERIAL_THRESHOLD 32768
+#define PARALLEL_ARRAY_GRAIN 4096 // 原生数组与 vector 的切分粒度
+
+namespace sjtu::parallel {
+
+    class thread_pool {
+    private:
+        sjtu::vector<std::thread> workers;
+        sjtu::deque<std::function<void()>> tasks;
+        std::mutex taskMutex;
+        std::condition_variable taskCond;
+        bool stopping;
+
+        void workerLoop() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(taskMutex);
+                    taskCond.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) return; // stopping
+                    task = std::move(*tasks.begin()); // front() 只有 const 版本, 经迭代器移出以免复制捕获的状态
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        void submit(const std::function<void()> &task) {
+            {
+                std::lock_guard<std::mutex> lock(taskMutex);
+                tasks.push_back(task);
+            }
+            taskCond.notify_one();
+        }
+
+    public:
+        // threadNum 包含调用线程本身, 即实际创建 threadNum - 1 个工作线程
+        explicit thread_pool(size_t threadNum = std::thread::hardware_concurrency()) : stopping(false) {
+            for (size_t i = 1; i < threadNum; ++i)
+                workers.emplace_back([this] { workerLoop(); });
+        }
+
+        thread_pool(const thread_pool &other) = delete;
+
+        thread_pool &operator=(const thread_pool &other) = delete;
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(taskMutex);
+                stopping = true;
+            }
+            taskCond.notify_all();
+            for (std::thread &worker:workers) worker.join();
+        }
+
+        size_t size() const { return workers.size() + 1; }
+
+        /**
+         * 执行 body(0) ... body(chunkNum - 1), 返回前等待全部完成
+         * 调用线程同样参与执行, 因此在任务内部再次调用 run 不会死锁
+         * 任一 body 抛出的异常在全部完成后重新抛出
+         */
+        template<typename Body>
+        void run(size_t chunkNum, Body &&body) {
+            if (workers.empty() || chunkNum <= 1) {
+                for (size_t i = 0; i < chunkNum; ++i) body(i);
+                return;
+            }
+            struct RunState {
+                std::atomic<size_t> nextChunk{0}, doneChunk{0};
+                std::mutex doneMutex;
+                std::condition_variable doneCond;
+                std::exception_ptr error;
+            };
+            // 工作线程可能在本次 run 返回后才取到任务, 因此状态由 shared_ptr 持有
+            // 此时 nextChunk 已取尽, 不会再访问 body
+            auto state = std::make_shared<RunState>();
+            auto work = [state, &body, chunkNum] {
+                size_t id;
+                while ((id = state->nextChunk.fetch_add(1)) < chunkNum) {
+                    try {
+                        body(id);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(state->doneMutex);
+                        if (!state->error) state->error = std::current_exception();
+                    }
+                    if (state->doneChunk.fetch_add(1) + 1 == chunkNum) {
+                        std::lock_guard<std::mutex> lock(state->doneMutex);
+                        state->doneCond.notify_all();
+                    }
+                }
+            };
+            size_t helperNum = (workers.size() < chunkNum - 1) ? workers.size() : chunkNum - 1;
+            for (size_t i = 0; i < helperNum; ++i) submit(work);
+            work();
+            std::unique_lock<std::mutex> lock(state->doneMutex);
+            state->doneCond.wait(lock, [&] { return state->doneChunk.load() == chunkNum; });
+            if (state->error) std::rethrow_exception(state->error);
+        }
+    };
+
+    inline thread_pool &default_pool() {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // 以下为算法的内部实现, 序列被看作若干段 (segment), 每个任务处理连续的若干段
+    // 段需提供 count(), length(s), at(s, i), totalSize()
+
+    template<typename T>
+    struct array_segments {
+        T *first;
+        size_t elementNum;
+
+        size_t count() const { return (elementNum + PARALLEL_ARRAY_GRAIN - 1) / PARALLEL_ARRAY_GRAIN; }
+
+        size_t length(size_t s) const {
+            size_t begin = s * PARALLEL_ARRAY_GRAIN;
+            return (elementNum - begin < PARALLEL_ARRAY_GRAIN) ? (elementNum - begin) : PARALLEL_ARRAY_GRAIN;
+        }
+
+        T &at(size_t s, size_t i) const { return first[s * PARALLEL_ARRAY_GRAIN + i]; }
+
+        size_t totalSize() const { return elementNum; }
+    };
+
+    // deque 的每个块即为一段 (deque_segments 为 deque 的友元)
+    template<class Deque>
+    struct deque_segments {
+        using block_type = typename Deque::ULLBlock;
+        using value_type = std::remove_reference_t<decltype(*std::declval<Deque &>().begin())>;
+
+        sjtu::vector<block_type *> blocks;
+        size_t elementNum;
+
+        explicit deque_segments(Deque &dq) : elementNum(dq.size()) {
+            for (block_type *p = dq.headBlock; p != nullptr; p = p->nxtBlock) blocks.push_back(p);
+        }
+
+        size_t count() const { return blocks.size(); }
+
+        size_t length(size_t s) const { return blocks[s]->elementNum; }
+
+        value_type &at(size_t s, size_t i) const { return blocks[s]->elementData()[i]; }
+
+        size_t totalSize() const { return elementNum; }
+    };
+
+    // 将全部段划分为若干任务, 执行 body(taskId, segBegin, segEnd), 返回任务数
+    template<typename Segments, typename Body>
+    size_t runSegments(const Segments &segs, thread_pool &pool, Body &&body) {
+        size_t segNum = segs.count();
+        if (segNum == 0) return 0;
+        if (segs.totalSize() < PARALLEL_SERIAL_THRESHOLD || pool.size() == 1) {
+            body(size_t(0), size_t(0), segNum);
+            return 1;
+        }
+        size_t taskNum = pool.size() * 4; // 多切分几份以平衡负载
+        if (taskNum > segNum) taskNum = segNum;
+        pool.run(taskNum, [&](size_t taskId) {
+            body(taskId, segNum * taskId / taskNum, segNum * (taskId + 1) / taskNum);
+        });
+        return taskNum;
+    }
+
+    template<typename Segments, typename Func>
+    void forEachImpl(const Segments &segs, Func &func, thread_pool &pool) {
+        runSegments(segs, pool, [&](size_t, size_t segBegin, size_t segEnd) {
+            for (size_t s = segBegin; s < segEnd; ++s)
+                for (size_t i = 0, len = segs.length(s); i < len; ++i) func(segs.at(s, i));
+        });
+    }
+
+    template<typename R, typename Segments, typename Func, typename BinaryOp>
+    R reduceImpl(const Segments &segs, R init, Func &mapFunc, BinaryOp &op, thread_pool &pool) {
+        size_t maxTask = pool.size() * 4;
+        sjtu::vector<R> partial;
+        sjtu::vector<char> hasPartial;
+        partial.resize(maxTask, init);
+        hasPartial.resize(maxTask, 0);
+        size_t taskNum = runSegments(segs, pool, [&](size_t taskId, size_t segBegin, size_t segEnd) {
+            bool started = false;
+            R &acc = partial[taskId];
+            for (size_t s = segBegin; s < segEnd; ++s)
+                for (size_t i = 0, len = segs.length(s); i < len; ++i) {
+                    if (started) acc = op(acc, mapFunc(segs.at(s, i)));
+                    else acc = mapFunc(segs.at(s, i)), started = true;
+                }
+            hasPartial[taskId] = started;
+        });
+        R result = init;
+        for (size_t i = 0; i < taskNum; ++i)
+            if (hasPartial[i]) result = op(result, partial[i]);
+        return result;
+    }
+
+    // 两趟扫描: 先求各任务区间的总和, 串行求前缀后再带偏移量各自扫描
+    template<typename InSegments, typename OutSegments, typename BinaryOp>
+    void scanImpl(const InSegments &in, const OutSegments &out, BinaryOp &op, thread_pool &pool) {
+        using R = std::remove_reference_t<decltype(out.at(0, 0))>;
+        size_t segNum = in.count();
+        if (segNum == 0) return;
+        auto scanRange = [&](size_t segBegin, size_t segEnd, const R *carry) {
+            bool started = (carry != nullptr);
+            R acc = started ? *carry : R();
+            for (size_t s = segBegin; s < segEnd; ++s)
+                for (size_t i = 0, len = in.length(s); i < len; ++i) {
+                    acc = started ? op(acc, in.at(s, i)) : R(in.at(s, i));
+                    started = true;
+                    out.at(s, i) = acc;
+                }
+        };
+        if (in.totalSize() < PARALLEL_SERIAL_THRESHOLD || pool.size() == 1) {
+            scanRange(0, segNum, nullptr);
+            return;
+        }
+        size_t taskNum = pool.size() * 4;
+        if (taskNum > segNum) taskNum = segNum;
+        sjtu::vector<R> taskSum;
+        sjtu::vector<char> hasSum;
+        taskSum.resize(taskNum);
+        hasSum.resize(taskNum, 0);
+        pool.run(taskNum, [&](size_t taskId) {
+            bool started = false;
+            R acc = R();
+            for (size_t s = segNum * taskId / taskNum, e = segNum * (taskId + 1) / taskNum; s < e; ++s)
+                for (size_t i = 0, len = in.length(s); i < len; ++i) {
+                    acc = started ? op(acc, in.at(s, i)) : R(in.at(s, i));
+                    started = true;
+                }
+            taskSum[taskId] = acc;
+            hasSum[taskId] = started;
+        });
+        // carry[i] 为前 i 个任务区间的总和
+        sjtu::vector<R> carry;
+        sjtu::vector<char> hasCarry;
+        carry.resize(taskNum);
+        hasCarry.resize(taskNum, 0);
+        for (size_t i = 1; i < taskNum; ++i) {
+            if (hasCarry[i - 1] && hasSum[i - 1]) carry[i] = op(carry[i - 1], taskSum[i - 1]);
+            else if (hasCarry[i - 1]) carry[i] = carry[i - 1];
+            else carry[i] = taskSum[i - 1];
+            hasCarry[i] = hasCarry[i - 1] || hasSum[i - 1];
+        }
+        pool.run(taskNum, [&](size_t taskId) {
+            scanRange(segNum * taskId / taskNum, segNum * (taskId + 1) / taskNum,
+                      hasCarry[taskId] ? &carry[taskId] : nullptr);
+        });
+    }
+
+    struct identity_map {
+        template<typename T>
+        T &&operator()(T &&x) const { return std::forward<T>(x); }
+    };
+
+    // ---------------------------------------------------------------- for_each
+
+    template<typename T, typename Func>
+    void for_each(T *first, T *last, Func func, thread_pool &pool = default_pool()) {
+        forEachImpl(array_segments<T>{first, size_t(last - first)}, func, pool);
+    }
+
+    template<typename T, class G, size_t N, typename Func>
+    void for_each(vector<T, G, N> &vec, Func func, thread_pool &pool = default_pool()) {
+        forEachImpl(array_segments<T>{vec.data(), vec.size()}, func, pool);
+    }
+
+    template<typename T, size_t B, size_t M, typename Func>
+    void for_each(deque<T, B, M> &dq, Func func, thread_pool &pool = default_pool()) {
+        forEachImpl(deque_segments<deque<T, B, M>>(dq), func, pool);
+    }
+
+    // ---------------------------------------------------------------- transform
+
+    // out[i] = func(first[i]), out 可与 first 相同
+    template<typename T, typename U, typename Func>
+    void transform(const T *first, const T *last, U *out, Func func, thread_pool &pool = default_pool()) {
+        array_segments<const T> in{first, size_t(last - first)};
+        runSegments(in, pool, [&](size_t, size_t segBegin, size_t segEnd) {
+            for (size_t s = segBegin; s < segEnd; ++s)
+                for (size_t i = 0, len = in.length(s); i < len; ++i)
+                    out[s * PARALLEL_ARRAY_GRAIN + i] = func(in.at(s, i));
+        });
+    }
+
+    // out 被调整为与 in 相同的大小
+    template<typename T, class G1, size_t N1, typename U, class G2, size_t N2, typename Func>
+    void transform(const vector<T, G1, N1> &in, vector<U, G2, N2> &out, Func func,
+                   thread_pool &pool = default_pool()) {
+        out.resize(in.size());
+        parallel::transform(in.data(), in.data() + in.size(), out.data(), func, pool);
+    }
+
+    // 原地变换: x = func(x)
+    template<typename T, size_t B, size_t M, typename Func>
+    void transform(deque<T, B, M> &dq, Func func, thread_pool &pool = default_pool()) {
+        auto assignFunc = [&func](T &x) { x = func(x); };
+        forEachImpl(deque_segments<deque<T, B, M>>(dq), assignFunc, pool);
+    }
+
+    // ---------------------------------------------------------------- reduce
+
+    template<typename T, typename BinaryOp = std::plus<>>
+    T reduce(const T *first, const T *last, T init, BinaryOp op = BinaryOp(), thread_pool &pool = default_pool()) {
+        identity_map mapFunc;
+        return reduceImpl<T>(array_segments<const T>{first, size_t(last - first)}, init, mapFunc, op, pool);
+    }
+
+    template<typename T, class G, size_t N, typename BinaryOp = std::plus<>>
+    T reduce(const vector<T, G, N> &vec, T init, BinaryOp op = BinaryOp(), thread_pool &pool = default_pool()) {
+        return parallel::reduce(vec.data(), vec.data() + vec.size(), init, op, pool);
+    }
+
+    template<typename T, size_t B, size_t M, typename BinaryOp = std::plus<>>
+    T reduce(deque<T, B, M> &dq, T init, BinaryOp op = BinaryOp(), thread_pool &pool = default_pool()) {
+        identity_map mapFunc;
+        return reduceImpl<T>(deque_segments<deque<T, B, M>>(dq), init, mapFunc, op, pool);
+    }
+
+    // ---------------------------------------------------------------- inclusive_scan
+
+    // out[i] = first[0] op ... op first[i], out 可与 first 相同
+    template<typename T, typename BinaryOp = std::plus<>>
+    void inclusive_scan(const T *first, const T *last, T *out, BinaryOp op = BinaryOp(),
+                        thread_pool &pool = default_pool()) {
+        size_t n = size_t(last - first);
+        scanImpl(array_segments<const T>{first, n}, array_segments<T>{out, n}, op, pool);
+    }
+
+    // 原地前缀和
+    template<typename T, class G, size_t N, typename BinaryOp = std::plus<>>
+    void inclusive_scan(vector<T, G, N> &vec, BinaryOp op = BinaryOp(), thread_pool &pool = default_pool()) {
+        parallel::inclusive_scan(vec.data(), vec.data() + vec.size(), vec.data(), op, pool);
+    }
+
+    template<typename T, size_t B, size_t M, typename BinaryOp = std::plus<>>
+    void inclusive_scan(deque<T, B, M> &dq, BinaryOp op = BinaryOp(), thread_pool &pool = default_pool()) {
+        deque_segments<deque<T, B, M>> segs(dq);
+        scanImpl(segs, segs, op, pool);
+    }
+
+    // ---------------------------------------------------------------- count_if
+
+    template<typename T, typename Pred>
+    size_t count_if(const T *first, const T *last, Pred pred, thread_pool &pool = default_pool()) {
+        auto mapFunc = [&pred](const T &x) -> size_t { return pred(x) ? 1 : 0; };
+        std::plus<size_t> op;
+        return reduceImpl<size_t>(array_segments<const T>{first, size_t(last - first)}, 0, mapFunc, op, pool);
+    }
+
+    template<typename T, class G, size_t N, typename Pred>
+    size_t count_if(const vector<T, G, N> &vec, Pred pred, thread_pool &pool = default_pool()) {
+        return parallel::count_if(vec.data(), vec.data() + vec.size(), pred, pool);
+    }
+
+    template<typename T, size_t B, size_t M, typename Pred>
+    size_t count_if(deque<T, B, M> &dq, Pred pred, thread_pool &pool = default_pool()) {
+        auto mapFunc = [&pred](const T &x) -> size_t { return pred(x) ? 1 : 0; };
+        std::plus<size_t> op;
+        return reduceImpl<size_t>(deque_segments<deque<T, B, M>>(dq), 0, mapFunc, op, pool);
+    }
+
+}
+
+#endif
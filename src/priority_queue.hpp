@@ -3,7 +3,9 @@
 
 #include <cstddef>
 #include <functional>
+#include <memory_resource>
 #include "exceptions.hpp"
+#include "utility.hpp" // newObject, deleteObject
 
 namespace sjtu {
 
@@ -11,37 +13,40 @@ namespace sjtu {
     class priority_queue {
     private:
         size_t elementNum;
+        std::pmr::memory_resource *memResource; // 结点与元素均由此分配
 
         class lNode {
         public:
             T *data;
             lNode *lChild, *rChild;
 
+            // data 与子树由 priority_queue 负责分配与释放 (见 deleteHeap)
             lNode() : data(nullptr), lChild(nullptr), rChild(nullptr) {}
-
-            explicit lNode(const T &arg) : lChild(nullptr), rChild(nullptr) { data = new T(arg); }
-
-            lNode(const lNode &other) : lChild(nullptr), rChild(nullptr) { data = new T(*(other.data)); }
-
-            ~lNode() {
-                delete data;
-                delete lChild;
-                delete rChild;
-            }
         } *root;
 
         Compare cmp;
 
+        void deleteNode(lNode *p) {
+            deleteObject(memResource, p->data);
+            deleteObject(memResource, p);
+        }
+
+        void deleteHeap(lNode *p) {
+            if (p == nullptr)return;
+            deleteHeap(p->lChild);
+            deleteHeap(p->rChild);
+            deleteNode(p);
+        }
+
         void dfsCopy(lNode *myself, lNode *other) {
-            // 本函数也可由 lNode::operator= 实现
             if (other->data != nullptr)
-                myself->data = new T(*(other->data));
+                myself->data = newObject<T>(memResource, *(other->data));
             if (other->lChild != nullptr) {
-                myself->lChild = new lNode;
+                myself->lChild = newObject<lNode>(memResource);
                 dfsCopy(myself->lChild, other->lChild);
             }
             if (other->rChild != nullptr) {
-                myself->rChild = new lNode;
+                myself->rChild = newObject<lNode>(memResource);
                 dfsCopy(myself->rChild, other->rChild);
             }
         }
@@ -67,26 +72,33 @@ namespace sjtu {
 
     public:
 
-        priority_queue() : elementNum(0), root(nullptr) {}
+        priority_queue() : priority_queue(std::pmr::get_default_resource()) {}
+
+        // 全部内存由 res 分配, 如传入 monotonic_buffer_resource 可整体丢弃
+        explicit priority_queue(std::pmr::memory_resource *res) : elementNum(0), memResource(res), root(nullptr) {}
 
-        priority_queue(const priority_queue &other) : elementNum(0), root(nullptr) {
+        // 与 std::pmr 容器一致, 拷贝构造使用默认内存资源
+        priority_queue(const priority_queue &other) : priority_queue(other, std::pmr::get_default_resource()) {}
+
+        priority_queue(const priority_queue &other, std::pmr::memory_resource *res)
+                : elementNum(0), memResource(res), root(nullptr) {
             if (other.root == nullptr) root = nullptr;
             else {
-                root = new lNode;
+                root = newObject<lNode>(memResource);
                 dfsCopy(root, other.root);
             }
             elementNum = other.elementNum;
         }
 
-        ~priority_queue() { delete root; }
+        ~priority_queue() { deleteHeap(root); }
 
 
         priority_queue &operator=(const priority_queue &other) {
             if (this == &other)return *this;
-            delete root;
+            deleteHeap(root);
             if (other.root == nullptr) root = nullptr;
             else {
-                root = new lNode;
+                root = newObject<lNode>(memResource);
                 dfsCopy(root, other.root);
             }
             elementNum = other.elementNum;
@@ -100,8 +112,13 @@ namespace sjtu {
         }
 
         void push(const T &arg) {
-            lNode *newNode = new lNode;
-            newNode->data = new T(arg);
+            lNode *newNode = newObject<lNode>(memResource);
+            try {
+                newNode->data = newObject<T>(memResource, arg);
+            } catch (...) {
+                deleteObject(memResource, newNode);
+                throw;
+            }
             newNode->lChild = nullptr;
             newNode->rChild = nullptr;
             root = dfsMerge(newNode, root);
@@ -111,28 +128,30 @@ namespace sjtu {
         void pop() {
             if (elementNum == 0)throw container_is_empty();
             lNode *lH = root->lChild, *rH = root->rChild;
-            root->lChild = root->rChild = nullptr;// 防止递归删除整棵树
-            delete root;
+            deleteNode(root);
             root = dfsMerge(lH, rH);
             --elementNum;
         }
 
         size_t size() const { return elementNum; }
 
+        std::pmr::memory_resource *resource() const { return memResource; }
+
         bool empty() const { return (elementNum == 0); }
 
         void merge(priority_queue &other) {
             if (this == &other)return;
             lNode *tempHeap;
             if (other.root == nullptr) tempHeap = nullptr;
+            else if (memResource->is_equal(*other.memResource)) tempHeap = other.root; // 同一内存资源时直接接管
             else {
-                tempHeap = new lNode;
+                tempHeap = newObject<lNode>(memResource);
                 dfsCopy(tempHeap, other.root);
+                other.deleteHeap(other.root);
             }
             root = dfsMerge(root, tempHeap);
             elementNum += other.elementNum;
 
-            delete other.root;
             other.root = nullptr;
             other.elementNum = 0;
         }
@@ -6,7 +6,9 @@
 #define PTL_SEGMENT_TREE_H
 
 #include "exceptions.hpp"
+#include "utility.hpp" // newObject, deleteObject
 #include <cstring> // memcpy
+#include <memory_resource>
 
 namespace PTL {
 
@@ -16,34 +18,38 @@ namespace PTL {
         const size_t sizePtr = sizeof(T *);
         T **data, **lazyTag;
         size_t elementNum, memorySize; // 此处 memroySize 单位为 sizeof(T)
+        std::pmr::memory_resource *memResource; // 结点数组与元素均由此分配
+
+        inline T *newT(const T &value) { return sjtu::newObject<T>(memResource, value); }
 
         inline void initMem() {
-            data = new T *[memorySize];
+            data = static_cast<T **>(memResource->allocate(sizePtr * memorySize, alignof(T *)));
             memset(data, 0, sizePtr * memorySize);
-            lazyTag = new T *[memorySize];
+            lazyTag = static_cast<T **>(memResource->allocate(sizePtr * memorySize, alignof(T *)));
             memset(lazyTag, 0, sizePtr * memorySize);
         }
 
         inline void delMem() {
-            for (size_t i = 0; i < elementNum; ++i) {
-                delete data[i];
-                delete lazyTag[i];
+            if (data == nullptr) return;
+            for (size_t i = 0; i < memorySize; ++i) {
+                sjtu::deleteObject(memResource, data[i]);
+                sjtu::deleteObject(memResource, lazyTag[i]);
             }
-            delete[] data;
-            delete[] lazyTag;
+            memResource->deallocate(data, sizePtr * memorySize, alignof(T *));
+            memResource->deallocate(lazyTag, sizePtr * memorySize, alignof(T *));
         }
 
 
         inline void pushUp(const size_t &p) {
             if (data[p]) *data[p] = *data[p << 1] + *data[p << 1 | 1];
-            else data[p] = new T(*data[p << 1] + *data[p << 1 | 1]);
+            else data[p] = newT(*data[p << 1] + *data[p << 1 | 1]);
         }
 
         inline void tag(const size_t &p, const size_t &l, const size_t &r, const T &k) {
             if (data[p]) *data[p] = *data[p] + (r - l) * k;
-            else data[p] = new T((r - l) * k);
+            else data[p] = newT((r - l) * k);
             if (lazyTag[p]) *lazyTag[p] = *lazyTag[p] + k;
-            else lazyTag[p] = new T(k);
+            else lazyTag[p] = newT(k);
         }
 
         inline void pushDown(const size_t &p, const size_t &l, const size_t &r) {
@@ -51,13 +57,13 @@ namespace PTL {
                 size_t mid = (l + r) >> 1;
                 tag(p << 1, l, mid, *lazyTag[p]);
                 tag(p << 1 | 1, mid, r, *lazyTag[p]);
-                delete lazyTag[p];
+                sjtu::deleteObject(memResource, lazyTag[p]);
                 lazyTag[p] = nullptr;
             }
         }
 
         void buildTree(size_t p, size_t l, size_t r, const T &initT) {
-            if (r - l == 1) data[p] = new T(initT);
+            if (r - l == 1) data[p] = newT(initT);
             else {
                 size_t mid = (l + r) >> 1;
                 buildTree(p << 1, l, mid, initT);
@@ -67,7 +73,7 @@ namespace PTL {
         }
 
         void buildTree(size_t p, size_t l, size_t r, T originData[]) {
-            if (r - l == 1) data[p] = new T(originData[l]);
+            if (r - l == 1) data[p] = newT(originData[l]);
             else {
                 size_t mid = (l + r) >> 1;
                 buildTree(p << 1, l, mid, originData);
@@ -79,7 +85,7 @@ namespace PTL {
         void _update(size_t p, size_t l, size_t r, const size_t &t, const T &k) {
             if (r - l == 1) {
                 if (data[p])*data[p] = *data[p] + k;
-                else data[p] = new T(*data[p] + k);
+                else data[p] = newT(*data[p] + k);
             } else {
                 pushDown(p, l, r);
                 size_t mid = (l + r) >> 1;
@@ -111,23 +117,28 @@ namespace PTL {
 
     public:
 
-        explicit segment_tree(size_t elementN, T initT)
-                : data(nullptr), elementNum(elementN), memorySize(elementN << 2) {
+        // 全部内存由 res 分配, 如传入 monotonic_buffer_resource 可整体丢弃
+        explicit segment_tree(size_t elementN, T initT,
+                              std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : data(nullptr), elementNum(elementN), memorySize(elementN << 2), memResource(res) {
             initMem();
             buildTree(1, 0, elementN, initT);
         }
 
-        explicit segment_tree(size_t elementN, T originData[])
-                : data(nullptr), elementNum(elementN), memorySize(elementN << 2) {
+        explicit segment_tree(size_t elementN, T originData[],
+                              std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : data(nullptr), elementNum(elementN), memorySize(elementN << 2), memResource(res) {
             initMem();
             buildTree(1, 0, elementN, originData);
         }
 
-        segment_tree(const segment_tree &other) : elementNum(other.elementNum), memorySize(other.memorySize) {
+        // 与 std::pmr 容器一致, 拷贝构造默认使用默认内存资源
+        segment_tree(const segment_tree &other, std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : elementNum(other.elementNum), memorySize(other.memorySize), memResource(res) {
             initMem();
             for (size_t i = 0; i < memorySize; ++i) {
-                data[i] = (other.data[i]) ? (new T(*other.data[i])) : (nullptr);
-                lazyTag[i] = (other.lazyTag[i]) ? (new T(*other.lazyTag[i])) : (nullptr);
+                data[i] = (other.data[i]) ? (newT(*other.data[i])) : (nullptr);
+                lazyTag[i] = (other.lazyTag[i]) ? (newT(*other.lazyTag[i])) : (nullptr);
             }
         }
 
@@ -141,14 +152,16 @@ namespace PTL {
             memorySize = other.memorySize;
             initMem();
             for (size_t i = 0; i < memorySize; ++i) {
-                data[i] = (other.data[i]) ? (new T(*other.data[i])) : (nullptr);
-                lazyTag[i] = (other.lazyTag[i]) ? (new T(*other.lazyTag[i])) : (nullptr);
+                data[i] = (other.data[i]) ? (newT(*other.data[i])) : (nullptr);
+                lazyTag[i] = (other.lazyTag[i]) ? (newT(*other.lazyTag[i])) : (nullptr);
             }
             return *this;
         }
 
         size_t size() const { return elementNum; }
 
+        std::pmr::memory_resource *resource() const { return memResource; }
+
         void clear() {
             delMem();
             elementNum = 0;
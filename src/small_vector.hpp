@@ -0,0 +1,20 @@
+#ifndef SJTU_SMALL_VECTOR_HPP
+#define SJTU_SMALL_VECTOR_HPP
+
+#include "vector.hpp"
+
+#include <cstddef>
+
+namespace sjtu {
+
+    /**
+     * 前 N 个元素直接存放于对象内部, 元素数超过 N 后才转移至堆上
+     * 接口与 vector 完全一致 (即带内联空间的 vector)
+     * 注意对象本身大小随 N * sizeof(T) 增长, 且内联状态下的移动需要逐个移动元素
+     */
+    template<typename T, size_t N, class GrowthPolicy = vector_growth<>>
+    using small_vector = vector<T, GrowthPolicy, N>;
+
+}
+
+#endif
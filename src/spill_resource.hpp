@@ -0,0 +1,269 @@
+#ifndef SJTU_SPILL_RESOURCE_HPP
+#define SJTU_SPILL_RESOURCE_HPP
+
+#include "exceptions.hpp"
+#include "vector.hpp"
+#include "deque.hpp"
+
+#include <cstddef>
+#include <cstdlib> // mkstemp
+#include <memory_resource>
+#include <new> // std::bad_alloc
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h> // posix_fallocate, posix_fadvise
+#include <sys/mman.h>
+#include <unistd.h> // ftruncate, unlink, close
+
+/**
+ * 以临时文件为后备存储的内存资源, 用于容量超过物理内存的 deque (见 make_spill_deque)
+ *   整个文件映射在一段预留的虚拟地址上, 文件按 chunk 增长; 不超过一个 chunk 的分配从文件中切出,
+ *   更大或对齐要求更高的分配交给 upstream
+ *   make_spill_deque 让 deque 的块目录改由 upstream 分配 (见 deque 的 indexRes), 因此文件中只有 deque 的块
+ * 驻留的 chunk 总量超过 memoryCap 时, 按 LRU 顺序把 chunk 写回文件并从内存中丢弃, 之后再访问时由缺页中断读回:
+ *   - 分配算作对所在 chunk 的一次使用 (随后就会写入), 移到 LRU 链表的末尾; 释放不读写槽位, 不算使用
+ *   - deque 的首块与末块所在的 chunk 被钉住 (经 deque_end_hook 报告), 不在 LRU 链表中, 永不淘汰,
+ *     因此首末块在作为首末块期间不会被换出, 队列式使用时只有把尚未驻留的中部块读入首块时才读盘
+ *   被钉住的 chunk 也计入 memoryCap; 单纯读取中部被丢弃的 chunk 会使其重新驻留而不计入 memoryCap
+ *   (这些是干净页, 内核可随时回收)
+ * 非线程安全, 与使用它的 deque 相同; 资源须比使用它的容器活得更久
+ */
+#define SPILL_CHUNK_BYTES (size_t(16) << 20)
+#define SPILL_RESERVE_BYTES (size_t(1) << 40) // 预留的虚拟地址空间, 即文件大小上限
+#define SPILL_SLOT_ALIGN 64
+
+namespace sjtu {
+
+    class spill_resource : public std::pmr::memory_resource {
+    private:
+        // 驻留且未被钉住的 chunk 经 lruPre/lruNxt 串成 LRU 链表, 表头最久未使用
+        struct Chunk {
+            size_t lruPre, lruNxt;
+            size_t pinNum;
+            bool resident;
+        };
+
+        static constexpr size_t noChunk = size_t(-1);
+
+        struct SizeClass {
+            size_t slotBytes;
+            sjtu::vector<char *> freeSlots;
+        };
+
+        std::pmr::memory_resource *upstream;
+        int fileDescriptor;
+        char *mapBase;
+        size_t reserveBytes, chunkBytes, memoryCap;
+
+        sjtu::vector<Chunk> chunks;
+        sjtu::vector<SizeClass> sizeClasses; // 块大小种类很少, 线性查找即可
+        size_t bumpOffset; // 文件中尚未切分的起始位置
+        size_t lruHead, lruTail;
+        size_t residentBytes, evictedNum;
+
+        bool inFile(const void *p) const {
+            auto *c = static_cast<const char *>(p);
+            return c >= mapBase && c < mapBase + reserveBytes;
+        }
+
+        SizeClass &sizeClass(size_t slotBytes) {
+            for (SizeClass &sc:sizeClasses)
+                if (sc.slotBytes == slotBytes) return sc;
+            sizeClasses.push_back(SizeClass{slotBytes, {}});
+            return sizeClasses[sizeClasses.size() - 1];
+        }
+
+        void lruUnlink(size_t id) {
+            Chunk &c = chunks[id];
+            if (c.lruPre != noChunk) chunks[c.lruPre].lruNxt = c.lruNxt;
+            else lruHead = c.lruNxt;
+            if (c.lruNxt != noChunk) chunks[c.lruNxt].lruPre = c.lruPre;
+            else lruTail = c.lruPre;
+            c.lruPre = c.lruNxt = noChunk;
+        }
+
+        void lruPushBack(size_t id) {
+            chunks[id].lruPre = lruTail;
+            chunks[id].lruNxt = noChunk;
+            if (lruTail != noChunk) chunks[lruTail].lruNxt = id;
+            else lruHead = id;
+            lruTail = id;
+        }
+
+        void evictChunk(size_t id) {
+            lruUnlink(id);
+            char *begin = mapBase + id * chunkBytes;
+            // 先同步写回, 页面变为干净页后才能被 POSIX_FADV_DONTNEED 从页缓存中丢弃
+            msync(begin, chunkBytes, MS_SYNC);
+            madvise(begin, chunkBytes, MADV_DONTNEED);
+            posix_fadvise(fileDescriptor, off_t(id * chunkBytes), off_t(chunkBytes), POSIX_FADV_DONTNEED);
+            chunks[id].resident = false;
+            residentBytes -= chunkBytes;
+            ++evictedNum;
+        }
+
+        // 超出 memoryCap 时从 LRU 表头淘汰; 被钉住的 chunk 不在链表中, 全部被钉住时允许超出
+        void evictOverCap() {
+            while (residentBytes > memoryCap && lruHead != noChunk) evictChunk(lruHead);
+        }
+
+        // 将 id 标记为驻留 (其数据由缺页中断读回), 调用时 id 不在 LRU 链表中
+        void makeResident(size_t id) {
+            if (chunks[id].resident) return;
+            chunks[id].resident = true;
+            residentBytes += chunkBytes;
+            evictOverCap();
+        }
+
+        void touchChunk(size_t id) {
+            if (chunks[id].pinNum > 0) return;
+            if (chunks[id].resident) lruUnlink(id);
+            else makeResident(id);
+            lruPushBack(id);
+        }
+
+        void pinChunk(const void *p) {
+            if (p == nullptr || !inFile(p)) return;
+            size_t id = size_t(static_cast<const char *>(p) - mapBase) / chunkBytes;
+            if (chunks[id].pinNum++ > 0) return;
+            if (chunks[id].resident) lruUnlink(id);
+            else makeResident(id);
+        }
+
+        void unpinChunk(const void *p) {
+            if (p == nullptr || !inFile(p)) return;
+            size_t id = size_t(static_cast<const char *>(p) - mapBase) / chunkBytes;
+            if (--chunks[id].pinNum > 0) return;
+            lruPushBack(id);
+            evictOverCap();
+        }
+
+        // 先钉住新的首末块再解除原来的, 首末块不变时不会被淘汰
+        static void pinEnds(void *context, const void *oldHead, const void *oldTail,
+                            const void *newHead, const void *newTail) {
+            auto *res = static_cast<spill_resource *>(context);
+            res->pinChunk(newHead);
+            res->pinChunk(newTail);
+            res->unpinChunk(oldHead);
+            res->unpinChunk(oldTail);
+        }
+
+        // 在文件末尾追加一个 chunk, 并预先分配磁盘空间 (否则磁盘写满时写入映射区会触发 SIGBUS)
+        void growFile() {
+            size_t offset = chunks.size() * chunkBytes;
+            if (offset + chunkBytes > reserveBytes) throw std::bad_alloc();
+            if (ftruncate(fileDescriptor, off_t(offset + chunkBytes)) != 0) throw std::bad_alloc();
+            if (posix_fallocate(fileDescriptor, off_t(offset), off_t(chunkBytes)) != 0) {
+                ftruncate(fileDescriptor, off_t(offset));
+                throw std::bad_alloc();
+            }
+            chunks.push_back(Chunk{noChunk, noChunk, 0, false});
+        }
+
+        void *do_allocate(size_t bytes, size_t alignment) override {
+            if (bytes > chunkBytes || alignment > SPILL_SLOT_ALIGN)
+                return upstream->allocate(bytes, alignment);
+            size_t slotBytes = (bytes + SPILL_SLOT_ALIGN - 1) / SPILL_SLOT_ALIGN * SPILL_SLOT_ALIGN;
+            SizeClass &sc = sizeClass(slotBytes);
+            char *slot;
+            if (!sc.freeSlots.empty()) {
+                slot = sc.freeSlots.back();
+                sc.freeSlots.pop_back();
+            } else {
+                // 槽位不跨越 chunk, chunk 末尾放不下的部分直接舍弃
+                if (bumpOffset + slotBytes > file_bytes()) {
+                    bumpOffset = file_bytes();
+                    growFile();
+                }
+                slot = mapBase + bumpOffset;
+                bumpOffset += slotBytes;
+            }
+            touchChunk(size_t(slot - mapBase) / chunkBytes);
+            return slot;
+        }
+
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+            if (!inFile(p)) {
+                upstream->deallocate(p, bytes, alignment);
+                return;
+            }
+            size_t slotBytes = (bytes + SPILL_SLOT_ALIGN - 1) / SPILL_SLOT_ALIGN * SPILL_SLOT_ALIGN;
+            sizeClass(slotBytes).freeSlots.push_back(static_cast<char *>(p)); // 不访问槽位内存, 不算使用
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    public:
+        /**
+         * memoryCap: 驻留在内存中的文件数据上限 (字节), 至少保留一个 chunk
+         * directory: 临时文件所在目录, 文件创建后立即 unlink, 进程退出后不留痕迹
+         * chunkBytes 取 memoryCap / 16 与 SPILL_CHUNK_BYTES 中较小者, 并向上取整到页大小
+         *   (被钉住的首末块 chunk 也占用 memoryCap, chunk 过大会挤占 LRU 链表能容纳的 chunk 数)
+         */
+        explicit spill_resource(size_t cap, const std::string &directory = "/tmp",
+                                std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : upstream(res), fileDescriptor(-1), mapBase(nullptr), reserveBytes(SPILL_RESERVE_BYTES),
+                  memoryCap(cap), bumpOffset(0), lruHead(noChunk), lruTail(noChunk), residentBytes(0), evictedNum(0) {
+            size_t pageBytes = size_t(sysconf(_SC_PAGESIZE));
+            chunkBytes = (memoryCap / 16 < SPILL_CHUNK_BYTES) ? memoryCap / 16 : SPILL_CHUNK_BYTES;
+            chunkBytes = (chunkBytes + pageBytes - 1) / pageBytes * pageBytes;
+            if (chunkBytes == 0) chunkBytes = pageBytes;
+            if (memoryCap < chunkBytes) memoryCap = chunkBytes;
+            reserveBytes = reserveBytes / chunkBytes * chunkBytes;
+
+            std::string path = directory + "/ptl-spill-XXXXXX";
+            fileDescriptor = mkstemp(path.data());
+            if (fileDescriptor < 0) throw runtime_error();
+            unlink(path.c_str());
+            void *base = mmap(nullptr, reserveBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE,
+                              fileDescriptor, 0);
+            if (base == MAP_FAILED) {
+                close(fileDescriptor);
+                throw runtime_error();
+            }
+            mapBase = static_cast<char *>(base);
+        }
+
+        spill_resource(const spill_resource &other) = delete;
+
+        spill_resource &operator=(const spill_resource &other) = delete;
+
+        ~spill_resource() override {
+            munmap(mapBase, reserveBytes);
+            close(fileDescriptor);
+        }
+
+        size_t memory_cap() const { return memoryCap; }
+
+        size_t chunk_bytes() const { return chunkBytes; }
+
+        size_t file_bytes() const { return chunks.size() * chunkBytes; }
+
+        size_t resident_bytes() const { return residentBytes; }
+
+        size_t evicted_chunks() const { return evictedNum; }
+
+        std::pmr::memory_resource *upstream_resource() const { return upstream; }
+
+        // 交给 deque::set_end_hook, 钉住其首块与末块所在的 chunk
+        deque_end_hook end_hook() { return deque_end_hook{&pinEnds, this}; }
+    };
+
+    /**
+     * 元素存放在 res 的文件中的 deque, 块形状与默认的 deque<T> 相同
+     *   (块内删除首元素需要平移整块, 块过大会拖慢 pop_front, 因此不为落盘单独放大块)
+     * 块目录由 res 的 upstream 分配, 首块与末块所在的 chunk 被钉在内存中
+     * 元素按字节写回磁盘再读回, 因此只接受可平凡复制的类型 (指针等指向内存中其他对象的类型也不应使用)
+     */
+    template<class T>
+    deque<T> make_spill_deque(spill_resource &res) {
+        static_assert(std::is_trivially_copyable_v<T>, "spilled deque elements must be trivially copyable");
+        deque<T> result(&res, res.upstream_resource());
+        result.set_end_hook(res.end_hook());
+        return result;
+    }
+
+}
+
+#endif
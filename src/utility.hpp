@@ -1,6 +1,9 @@
 #ifndef SJTU_UTILITY_HPP
 #define SJTU_UTILITY_HPP
 
+#include <cstddef>
+#include <memory_resource>
+#include <tuple>
 #include <utility>
 
 namespace sjtu {
@@ -15,13 +18,34 @@ public:
 	pair(pair &&other) = default;
 	pair(const T1 &x, const T2 &y) : first(x), second(y) {}
 	template<class U1, class U2>
-	pair(U1 &&x, U2 &&y) : first(x), second(y) {}
+	pair(U1 &&x, U2 &&y) : first(std::forward<U1>(x)), second(std::forward<U2>(y)) {}
 	template<class U1, class U2>
 	pair(const pair<U1, U2> &other) : first(other.first), second(other.second) {}
 	template<class U1, class U2>
-	pair(pair<U1, U2> &&other) : first(other.first), second(other.second) {}
+	pair(pair<U1, U2> &&other) : first(std::forward<U1>(other.first)), second(std::forward<U2>(other.second)) {}
+	// 分别以两组参数原地构造 first 与 second, 用于 map::try_emplace 等
+	template<class... Args1, class... Args2>
+	pair(std::piecewise_construct_t, std::tuple<Args1...> args1, std::tuple<Args2...> args2)
+			: pair(args1, args2, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>()) {}
+
+private:
+	template<class Tuple1, class Tuple2, size_t... I1, size_t... I2>
+	pair(Tuple1 &args1, Tuple2 &args2, std::index_sequence<I1...>, std::index_sequence<I2...>)
+			: first(std::get<I1>(std::move(args1))...), second(std::get<I2>(std::move(args2))...) {}
 };
 
+// 在 resource 上分配并构造 / 析构并归还单个对象, 各容器以此代替全局 new / delete
+// 与 delete 相同, deleteObject 传入 nullptr 时不做任何事
+template<class T, class... Args>
+T *newObject(std::pmr::memory_resource *resource, Args &&... args) {
+	return std::pmr::polymorphic_allocator<>(resource).new_object<T>(std::forward<Args>(args)...);
+}
+
+template<class T>
+void deleteObject(std::pmr::memory_resource *resource, T *p) {
+	if (p != nullptr) std::pmr::polymorphic_allocator<>(resource).delete_object(p);
+}
+
 }
 
 #endif
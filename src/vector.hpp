@@ -5,195 +5,499 @@
 
 #include <climits>
 #include <cstddef>
-#include <cstring> // memcpy
+#include <cstring> // memcpy, memmove
+#include <memory_resource>
+#include <new> // placement new
+#include <span>
+#include <type_traits>
+#include <iterator> // std::iterator_traits
+#include <utility> // std::forward, std::move
 
 #define VECTOR_INITIAL_SIZE 8
 
+/**
+ * 定义 PTL_VECTOR_CHECKED / PTL_VECTOR_UNCHECKED 以开启 / 关闭 operator[] 的越界检查 (at 始终检查)
+ * 均未定义时, release 构建 (NDEBUG) 关闭检查
+ */
+#if !defined(PTL_VECTOR_CHECKED) && !defined(PTL_VECTOR_UNCHECKED) && defined(NDEBUG)
+#define PTL_VECTOR_UNCHECKED
+#endif
+
 namespace sjtu {
 
-    template<typename T>
+    /**
+     * vector 扩容策略: 容量不足时新容量为 max(当前容量 * NUMERATOR / DENOMINATOR, 所需容量)
+     * 默认 2 倍扩容; vector_growth<3, 2> 以更多的扩容次数换取更少的内存浪费
+     * 自定义策略只需提供 static size_t next(size_t memorySize, size_t required)
+     */
+    template<size_t NUMERATOR = 2, size_t DENOMINATOR = 1>
+    struct vector_growth {
+        static_assert(DENOMINATOR > 0 && NUMERATOR > DENOMINATOR, "vector_growth factor must be greater than 1");
+
+        static size_t next(size_t memorySize, size_t required) {
+            size_t newSize = (memorySize == 0) ? VECTOR_INITIAL_SIZE
+                                               : memorySize / DENOMINATOR * NUMERATOR
+                                                 + memorySize % DENOMINATOR * NUMERATOR / DENOMINATOR;
+            if (newSize <= memorySize) newSize = memorySize + 1;
+            return (newSize < required) ? required : newSize;
+        }
+    };
+
+    /**
+     * INLINE_CAPACITY > 0 时 (见 small_vector.hpp) 对象内部预留该数量元素的空间, 元素数超出后才转移至堆上
+     * 默认为 0, 此时不占用任何额外空间
+     */
+    template<typename T, class GrowthPolicy = vector_growth<>, size_t INLINE_CAPACITY = 0>
     class vector {
     private:
-        const size_t sizePtr = sizeof(T *);
-        T **data;
+#ifdef PTL_VECTOR_UNCHECKED
+        static constexpr bool checkedAccess = false;
+#else
+        static constexpr bool checkedAccess = true;
+#endif
+
+        // 元素连续存放于 elementData[0, elementNum), 由 placement new 构造, 其后为未构造的原始内存
+        T *elementData;
         size_t elementNum, memorySize; // 此处 memroySize 单位为 sizeof(T)
+        std::pmr::memory_resource *memResource; // 所有堆内存均由此分配
+
+        struct NoInlineBuffer {
+        };
+
+        struct InlineBuffer {
+            alignas(T) unsigned char bytes[sizeof(T) * INLINE_CAPACITY];
+        };
+
+        [[no_unique_address]] std::conditional_t<INLINE_CAPACITY == 0, NoInlineBuffer, InlineBuffer> inlineBuffer;
+
+        T *inlineData() {
+            if constexpr (INLINE_CAPACITY == 0) return nullptr;
+            else return reinterpret_cast<T *>(inlineBuffer.bytes);
+        }
+
+        bool isInline() const {
+            if constexpr (INLINE_CAPACITY == 0) return false;
+            else return static_cast<const void *>(elementData) == inlineBuffer.bytes;
+        }
+
+        // 空状态: 无内联空间时不持有内存, 否则使用内联空间
+        inline void resetEmpty() {
+            elementData = inlineData();
+            elementNum = 0;
+            memorySize = INLINE_CAPACITY;
+        }
+
+        T *allocMem(size_t n) { return static_cast<T *>(memResource->allocate(sizeof(T) * n, alignof(T))); }
+
+        void freeMem(T *p, size_t n) { memResource->deallocate(p, sizeof(T) * n, alignof(T)); }
+
+        // T 可平凡拷贝 (必然可平凡析构) 时, 拷贝/移动均等价于逐字节复制, 析构为空操作
+        // 以下各处对此情况直接使用 memcpy / memmove
+        static constexpr bool trivialElement = std::is_trivially_copyable_v<T>;
+
+        static void bytesCopy(T *dest, const T *src, size_t n) {
+            if (n != 0) memcpy(static_cast<void *>(dest), static_cast<const void *>(src), sizeof(T) * n);
+        }
+
+        static void bytesMove(T *dest, const T *src, size_t n) {
+            if (n != 0) memmove(static_cast<void *>(dest), static_cast<const void *>(src), sizeof(T) * n);
+        }
+
+        static void destroyRange(T *first, T *last) {
+            if constexpr (!std::is_trivially_destructible_v<T>)
+                for (; first != last; ++first) first->~T();
+        }
+
+        // 将 [first, last) 拷贝构造至 dest 起的未构造内存, 异常时析构已构造部分
+        static void copyConstructRange(const T *first, const T *last, T *dest) {
+            if constexpr (trivialElement) {
+                bytesCopy(dest, first, last - first);
+                return;
+            }
+            T *cur = dest;
+            try {
+                for (; first != last; ++first, ++cur) new(cur) T(*first);
+            } catch (...) {
+                destroyRange(dest, cur);
+                throw;
+            }
+        }
+
+        // 扩容时若 T 的移动构造为 noexcept 则移动, 否则拷贝 (保证强异常安全)
+        static void relocateRange(T *first, T *last, T *dest) {
+            if constexpr (trivialElement) bytesCopy(dest, first, last - first);
+            else if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>)
+                for (; first != last; ++first, ++dest) new(dest) T(std::move(*first));
+            else copyConstructRange(first, last, dest);
+        }
 
         inline void initMem() {
-            data = new T *[memorySize];
-            memset(data, 0, sizePtr * memorySize);
+            if (memorySize <= INLINE_CAPACITY) {
+                elementData = inlineData();
+                memorySize = INLINE_CAPACITY;
+            } else elementData = allocMem(memorySize);
+        }
+
+        // 空 vector 不持有堆内存, 首次超出 INLINE_CAPACITY 时按 GrowthPolicy 分配
+        inline size_t nextMemSize() const { return GrowthPolicy::next(memorySize, elementNum + 1); }
+
+        // 将全部元素搬至容量为 newSize (>= elementNum) 的新内存
+        // newSize 不超过 INLINE_CAPACITY 时搬回内联空间 (无内联空间且 newSize 为 0 时即释放内存)
+        void reallocMem(size_t newSize) {
+            bool toInline = (newSize <= INLINE_CAPACITY);
+            if (toInline && isInline()) return;
+            T *newData = toInline ? inlineData() : allocMem(newSize);
+            try {
+                relocateRange(elementData, elementData + elementNum, newData);
+            } catch (...) {
+                if (!toInline) freeMem(newData, newSize);
+                throw;
+            }
+            delMem();
+            elementData = newData;
+            memorySize = toInline ? INLINE_CAPACITY : newSize;
         }
 
         inline void delMem() {
-            for (size_t i = 0; i < elementNum; ++i)
-                delete data[i];
-            delete[] data;
+            destroyRange(elementData, elementData + elementNum);
+            if (!isInline() && elementData != nullptr) freeMem(elementData, memorySize);
+        }
+
+        template<typename... Args>
+        void resizeImpl(size_t newSize, const Args &... args) {
+            if (newSize <= elementNum) {
+                destroyRange(elementData + newSize, elementData + elementNum);
+                elementNum = newSize;
+                return;
+            }
+            if (newSize > memorySize) {
+                if constexpr (sizeof...(Args) == 0) reallocMem(GrowthPolicy::next(memorySize, newSize));
+                else { // value 可能为本 vector 中的元素, 先构造副本
+                    T tempValue(args...);
+                    reallocMem(GrowthPolicy::next(memorySize, newSize));
+                    resizeImpl(newSize, tempValue);
+                    return;
+                }
+            }
+            size_t i = elementNum;
+            try {
+                for (; i < newSize; ++i) new(elementData + i) T(args...);
+            } catch (...) {
+                destroyRange(elementData + elementNum, elementData + i);
+                throw;
+            }
+            elementNum = newSize;
+        }
+
+        // 扩容至 newSize, 同时在下标 gap 处用 args 构造新元素
+        // 新元素先于旧元素构造, 因此 args 引用本 vector 中的元素也是安全的
+        template<typename... Args>
+        void reallocInsert(size_t newSize, size_t gap, Args &&... args) {
+            T *newData = allocMem(newSize);
+            try {
+                new(newData + gap) T(std::forward<Args>(args)...);
+            } catch (...) {
+                freeMem(newData, newSize);
+                throw;
+            }
+            try {
+                relocateRange(elementData, elementData + gap, newData);
+                try {
+                    relocateRange(elementData + gap, elementData + elementNum, newData + gap + 1);
+                } catch (...) {
+                    destroyRange(newData, newData + gap);
+                    throw;
+                }
+            } catch (...) {
+                newData[gap].~T();
+                freeMem(newData, newSize);
+                throw;
+            }
+            delMem();
+            elementData = newData;
+            memorySize = newSize;
+        }
+
+        // 在下标 id 处插入 n 个元素, 尾部元素只整体搬移一次, 容量至多扩充一次
+        // fill(dest, constructed) 按顺序产生第 k 个新元素: constructed 为 true 时 dest 处已有对象, 应赋值
+        template<typename Filler>
+        void insertN(size_t id, size_t n, Filler fill) {
+            if (n == 0) return;
+            if (elementNum + n > memorySize) {
+                size_t newSize = GrowthPolicy::next(memorySize, elementNum + n);
+                T *newData = allocMem(newSize);
+                size_t k = 0;
+                try {
+                    for (; k < n; ++k) fill(newData + id + k, false);
+                } catch (...) {
+                    destroyRange(newData + id, newData + id + k);
+                    freeMem(newData, newSize);
+                    throw;
+                }
+                try {
+                    relocateRange(elementData, elementData + id, newData);
+                    try {
+                        relocateRange(elementData + id, elementData + elementNum, newData + id + n);
+                    } catch (...) {
+                        destroyRange(newData, newData + id);
+                        throw;
+                    }
+                } catch (...) {
+                    destroyRange(newData + id, newData + id + n);
+                    freeMem(newData, newSize);
+                    throw;
+                }
+                delMem();
+                elementData = newData;
+                memorySize = newSize;
+                elementNum += n;
+            } else {
+                // 原地插入: 抛出异常时 [0, elementNum) 仍全部有效, 且不遗留 elementNum 之后已构造的对象
+                size_t tailNum = elementNum - id;
+                if constexpr (trivialElement) {
+                    bytesMove(elementData + id + n, elementData + id, tailNum);
+                    size_t k = 0;
+                    try {
+                        for (; k < n; ++k) fill(elementData + id + k, false);
+                    } catch (...) {
+                        bytesMove(elementData + id, elementData + id + n, tailNum);
+                        throw;
+                    }
+                    elementNum += n;
+                } else if (tailNum > n) {
+                    // 新构造的对象恰好接在末尾, 每构造一个就计入 elementNum
+                    for (size_t i = elementNum - n, oldNum = elementNum; i < oldNum; ++i, ++elementNum)
+                        new(elementData + i + n) T(std::move(elementData[i]));
+                    for (size_t i = elementNum - 2 * n; i > id; --i) elementData[i - 1 + n] = std::move(elementData[i - 1]);
+                    for (size_t k = 0; k < n; ++k) fill(elementData + id + k, true);
+                } else {
+                    // 尾部移至 [id + n, elementNum + n), 中间的 [elementNum, id + n) 由 fill 构造, 失败时析构二者
+                    size_t movedNum = 0, k = 0;
+                    try {
+                        for (; movedNum < tailNum; ++movedNum)
+                            new(elementData + id + n + movedNum) T(std::move(elementData[id + movedNum]));
+                        for (; k < n; ++k) fill(elementData + id + k, k < tailNum);
+                    } catch (...) {
+                        if (k > tailNum) destroyRange(elementData + elementNum, elementData + id + k);
+                        destroyRange(elementData + id + n, elementData + id + n + movedNum);
+                        throw;
+                    }
+                    elementNum += n;
+                }
+            }
+        }
+
+        // 仅支持单趟遍历的迭代器 (如 istream_iterator) 无法预先求出区间长度
+        template<typename InputIt>
+        static constexpr bool isSinglePass() {
+            if constexpr (requires { typename std::iterator_traits<InputIt>::iterator_category; })
+                return std::is_same_v<typename std::iterator_traits<InputIt>::iterator_category,
+                        std::input_iterator_tag>;
+            else return false;
+        }
+
+        template<typename InputIt>
+        static size_t rangeDistance(InputIt first, const InputIt &last) {
+            if constexpr (requires { last - first; }) return size_t(last - first);
+            else {
+                size_t n = 0;
+                for (; first != last; ++first) ++n;
+                return n;
+            }
         }
 
     public:
         class const_iterator;
 
+        // 迭代器仅包装元素指针, 循环可被编译器视作普通指针循环进行向量化
         class iterator {
         private:
             friend class const_iterator;
 
-            friend class vector<T>;
+            friend class vector;
 
-            vector<T> *subject;
-            size_t index;
-
-            /* 安全性是不存在的
-            inline void checkUninitialized() {
-                if (subject == nullptr) throw invalid_iterator("Try to Operate Uninitialized Iterator");
-            }*/
+            T *ptr;
 
         public:
+            using iterator_category = std::random_access_iterator_tag;
+            using iterator_concept = std::contiguous_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T *;
+            using reference = T &;
 
-            iterator() : subject(nullptr), index(0) {}
+            iterator() : ptr(nullptr) {}
 
-            iterator(vector<T> *sub, size_t id) : subject(sub), index(id) {}
+            explicit iterator(T *p) : ptr(p) {}
 
 
-            iterator operator+(const int &n) const { return iterator(subject, index + n); }
+            iterator operator+(const difference_type &n) const { return iterator(ptr + n); }
 
-            /*无符号类型与有符号类型变量同时出现在运算中时默认转为无符号
-            if ((n > 0 && n >= -index) || (n < 0 && -n > index))// n>0 处判断是否溢出size_t范围
-                throw invalid_iterator("Index out of Range of size_t (operator+)");*/
+            friend iterator operator+(const difference_type &n, const iterator &it) { return iterator(it.ptr + n); }
 
-            iterator operator-(const int &n) const { return iterator(subject, index - n); }
+            iterator operator-(const difference_type &n) const { return iterator(ptr - n); }
 
-            /*if ((n > 0 && n > index) || (n < 0 && -n >= -index))
-                throw invalid_iterator("Index out of Range of size_t (operator-)");*/
+            difference_type operator-(const iterator &rhs) const { return ptr - rhs.ptr; }
 
 
-            int operator-(const iterator &rhs) const {
-                if (subject != rhs.subject)throw invalid_iterator();
-                    //"Try to Minus Two Iterators of Different Vector"
-                else return int(index - rhs.index); // 此处也很危险
-            }
-
-
-            iterator &operator+=(const int &n) {
-                index += n;
+            iterator &operator+=(const difference_type &n) {
+                ptr += n;
                 return (*this);
             }
 
-            iterator &operator-=(const int &n) {
-                index -= n;
+            iterator &operator-=(const difference_type &n) {
+                ptr -= n;
                 return (*this);
             }
 
 
-            iterator operator++(int) {
-                ++index;
-                return (*this);
-            }// iter++
+            iterator operator++(int) { return iterator(ptr++); }// iter++
 
             iterator &operator++() {
-                ++index;
+                ++ptr;
                 return (*this);
             }// ++iter
 
-            iterator operator--(int) {
-                --index;
-                return (*this);
-            }// iter--
+            iterator operator--(int) { return iterator(ptr--); }// iter--
 
             iterator &operator--() {
-                --index;
+                --ptr;
                 return (*this);
             }// --iter
 
 
-            T &operator*() const { return *(subject->data[index]); }// *iter
+            T &operator*() const { return *ptr; }// *iter
 
+            T *operator->() const { return ptr; }
 
-            bool operator==(const iterator &rhs) const { return (index == rhs.index && subject == rhs.subject); }
+            T &operator[](const difference_type &n) const { return ptr[n]; }
 
-            bool operator==(const const_iterator &rhs) const { return (index == rhs.index && subject == rhs.subject); }
 
-            bool operator!=(const iterator &rhs) const { return (index != rhs.index || subject != rhs.subject); }
+            bool operator==(const iterator &rhs) const { return ptr == rhs.ptr; }
 
-            bool operator!=(const const_iterator &rhs) const { return (index != rhs.index || subject != rhs.subject); }
+            bool operator==(const const_iterator &rhs) const { return ptr == rhs.ptr; }
+
+            bool operator!=(const iterator &rhs) const { return ptr != rhs.ptr; }
+
+            bool operator!=(const const_iterator &rhs) const { return ptr != rhs.ptr; }
+
+            auto operator<=>(const iterator &rhs) const { return ptr <=> rhs.ptr; }
         };
 
         class const_iterator {
         private:
             friend class iterator;
 
-            friend class vector<T>;
+            friend class vector;
 
-            const vector<T> *subject;
-            size_t index;
+            const T *ptr;
 
         public:
+            using iterator_category = std::random_access_iterator_tag;
+            using iterator_concept = std::contiguous_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T *;
+            using reference = const T &;
 
-            const_iterator() : subject(nullptr), index(0) {}
-
-            const_iterator(const vector<T> *sub, size_t id) : subject(sub), index(id) {}
+            const_iterator() : ptr(nullptr) {}
 
+            explicit const_iterator(const T *p) : ptr(p) {}
 
-            const_iterator operator+(const int &n) const { return iterator(subject, index + n); }
+            const_iterator(const iterator &other) : ptr(other.ptr) {}
 
-            const_iterator operator-(const int &n) const { return iterator(subject, index - n); }
 
+            const_iterator operator+(const difference_type &n) const { return const_iterator(ptr + n); }
 
-            int operator-(const const_iterator &rhs) const {
-                if (subject != rhs.subject) throw invalid_iterator();
-                    //"Try to Minus Two Iterators of Different Vector (const_iterator)"
-                else return (index - rhs.index);
+            friend const_iterator operator+(const difference_type &n, const const_iterator &it) {
+                return const_iterator(it.ptr + n);
             }
 
+            const_iterator operator-(const difference_type &n) const { return const_iterator(ptr - n); }
 
-            const_iterator &operator+=(const int &n) {
-                index += n;
+            difference_type operator-(const const_iterator &rhs) const { return ptr - rhs.ptr; }
+
+
+            const_iterator &operator+=(const difference_type &n) {
+                ptr += n;
                 return (*this);
             }
 
-            const_iterator &operator-=(const int &n) {
-                index -= n;
+            const_iterator &operator-=(const difference_type &n) {
+                ptr -= n;
                 return (*this);
             }
 
 
-            const_iterator operator++(int) {
-                ++index;
-                return (*this);
-            }// iter++
+            const_iterator operator++(int) { return const_iterator(ptr++); }// iter++
 
             const_iterator &operator++() {
-                ++index;
+                ++ptr;
                 return (*this);
             }// ++iter
 
-            const_iterator operator--(int) {
-                --index;
-                return (*this);
-            }// iter--
+            const_iterator operator--(int) { return const_iterator(ptr--); }// iter--
 
             const_iterator &operator--() {
-                --index;
+                --ptr;
                 return (*this);
             }// --iter
 
 
-            const T &operator*() const { return *(subject->data[index]); }// *iter
+            const T &operator*() const { return *ptr; }// *iter
 
-            bool operator==(const iterator &rhs) const { return (index == rhs.index && subject == rhs.subject); }
+            const T *operator->() const { return ptr; }
 
-            bool operator==(const const_iterator &rhs) const { return (index == rhs.index && subject == rhs.subject); }
+            const T &operator[](const difference_type &n) const { return ptr[n]; }
 
-            bool operator!=(const iterator &rhs) const { return (index != rhs.index || subject != rhs.subject); }
+            bool operator==(const iterator &rhs) const { return ptr == rhs.ptr; }
 
-            bool operator!=(const const_iterator &rhs) const { return (index != rhs.index || subject != rhs.subject); }
+            bool operator==(const const_iterator &rhs) const { return ptr == rhs.ptr; }
+
+            bool operator!=(const iterator &rhs) const { return ptr != rhs.ptr; }
+
+            bool operator!=(const const_iterator &rhs) const { return ptr != rhs.ptr; }
+
+            auto operator<=>(const const_iterator &rhs) const { return ptr <=> rhs.ptr; }
         };
 
 
-        vector() : data(nullptr), elementNum(0), memorySize(VECTOR_INITIAL_SIZE) { initMem(); }
+    private:
+        // 迭代器位于 [begin(), end()] 之外时得到的下标必然越界, 由调用者抛出 index_out_of_bound
+        size_t indexOf(const const_iterator &pos) const { return size_t(pos.ptr - elementData); }
 
-        vector(const vector &other) : elementNum(other.elementNum), memorySize(other.memorySize) {
+    public:
+        vector() : vector(std::pmr::get_default_resource()) {}
+
+        // 全部内存由 res 分配, 如传入 monotonic_buffer_resource 可整体丢弃
+        explicit vector(std::pmr::memory_resource *res)
+                : elementData(inlineData()), elementNum(0), memorySize(INLINE_CAPACITY), memResource(res) {}
+
+        // 与 std::pmr 容器一致, 拷贝构造使用默认内存资源
+        vector(const vector &other) : vector(other, std::pmr::get_default_resource()) {}
+
+        vector(const vector &other, std::pmr::memory_resource *res)
+                : elementNum(other.elementNum), memorySize(other.elementNum), memResource(res) {
             initMem();
-            for (size_t i = 0; i < elementNum; ++i)data[i] = new T(*(other.data[i]));
-            // 如果直接 operator new() 返回类型为 void*
+            try {
+                copyConstructRange(other.elementData, other.elementData + elementNum, elementData);
+            } catch (...) {
+                if (!isInline()) freeMem(elementData, memorySize);
+                throw;
+            }
+        }
+
+        // 堆上的内存直接接管; 内联空间中的元素只能逐个移动
+        vector(vector &&other) noexcept(INLINE_CAPACITY == 0 || std::is_nothrow_move_constructible_v<T>)
+                : elementData(other.elementData), elementNum(other.elementNum), memorySize(other.memorySize),
+                  memResource(other.memResource) {
+            if (other.isInline()) {
+                resetEmpty();
+                relocateRange(other.elementData, other.elementData + other.elementNum, elementData);
+                elementNum = other.elementNum;
+                destroyRange(other.elementData, other.elementData + other.elementNum);
+            }
+            other.resetEmpty();
         }
 
         ~vector() { delMem(); }
@@ -201,11 +505,49 @@ namespace sjtu {
 
         vector &operator=(const vector &other) {
             if (this == &other)return *this;
+            if (other.elementNum <= memorySize && trivialElement) {
+                bytesCopy(elementData, other.elementData, other.elementNum);
+                elementNum = other.elementNum;
+                return *this;
+            }
+            if (other.elementNum <= memorySize) { // 容量足够时复用已有内存与元素
+                size_t commonNum = (elementNum < other.elementNum) ? elementNum : other.elementNum;
+                for (size_t i = 0; i < commonNum; ++i)elementData[i] = other.elementData[i];
+                if (other.elementNum > elementNum)
+                    copyConstructRange(other.elementData + elementNum, other.elementData + other.elementNum, elementData + elementNum);
+                else destroyRange(elementData + other.elementNum, elementData + elementNum);
+                elementNum = other.elementNum;
+                return *this;
+            }
+            T *newData = allocMem(other.elementNum);
+            try {
+                copyConstructRange(other.elementData, other.elementData + other.elementNum, newData);
+            } catch (...) {
+                freeMem(newData, other.elementNum);
+                throw;
+            }
             delMem();
-            elementNum = other.elementNum;
-            memorySize = other.memorySize;
-            initMem();
-            for (size_t i = 0; i < elementNum; ++i)data[i] = new T(*(other.data[i]));
+            elementData = newData;
+            elementNum = memorySize = other.elementNum;
+            return *this;
+        }
+
+        // 移动赋值直接接管 other 的内存, 因此同时采用 other 的内存资源 (拷贝赋值则保留自身的内存资源)
+        vector &operator=(vector &&other) noexcept(INLINE_CAPACITY == 0 || std::is_nothrow_move_constructible_v<T>) {
+            if (this == &other)return *this;
+            delMem();
+            memResource = other.memResource;
+            if (other.isInline()) {
+                resetEmpty();
+                relocateRange(other.elementData, other.elementData + other.elementNum, elementData);
+                elementNum = other.elementNum;
+                destroyRange(other.elementData, other.elementData + other.elementNum);
+            } else {
+                elementData = other.elementData;
+                elementNum = other.elementNum;
+                memorySize = other.memorySize;
+            }
+            other.resetEmpty();
             return *this;
         }
 
@@ -213,112 +555,235 @@ namespace sjtu {
         T &at(const size_t &pos) {
             if (pos >= elementNum)throw index_out_of_bound();
                 //"Try to Get Vector Element Out of Range (at)"
-            else return *(data[pos]);
+            else return elementData[pos];
         }
 
         const T &at(const size_t &pos) const {
             if (pos >= elementNum)throw index_out_of_bound();
                 // "Try to Get Vector Element Out of Range (const at)"
-            else return *(data[pos]);
+            else return elementData[pos];
         }
 
         T &operator[](const size_t &pos) {
-            if (pos >= elementNum)throw index_out_of_bound();
-                // "Try to Get Vector Element Out of Range (operator[])"
-            else return *(data[pos]);
+            if constexpr (checkedAccess)
+                if (pos >= elementNum)throw index_out_of_bound();
+            // "Try to Get Vector Element Out of Range (operator[])"
+            return elementData[pos];
         }
 
         const T &operator[](const size_t &pos) const {
-            if (pos >= elementNum)throw index_out_of_bound();
-                //"Try to Get Vector Element Out of Range (const operator[])"
-            else return *(data[pos]);
+            if constexpr (checkedAccess)
+                if (pos >= elementNum)throw index_out_of_bound();
+            //"Try to Get Vector Element Out of Range (const operator[])"
+            return elementData[pos];
         }
 
 
         const T &front() const {
             if (elementNum == 0)throw container_is_empty();
                 //"Try to Get Empty Vector's Front Element"
-            else return *(data[0]);
+            else return elementData[0];
         }
 
         const T &back() const {
             if (elementNum == 0)throw container_is_empty();
                 //"Try to Get Empty Vector's Back Element"
-            else return *(data[elementNum - 1]);
+            else return elementData[elementNum - 1];
         }
 
 
-        iterator begin() { return iterator(this, 0); }
+        iterator begin() { return iterator(elementData); }
+
+        const_iterator begin() const { return const_iterator(elementData); }
+
+        const_iterator cbegin() const { return const_iterator(elementData); }
 
-        const_iterator cbegin() const { return const_iterator(this, 0); }
+        iterator end() { return iterator(elementData + elementNum); }
 
-        iterator end() { return iterator(this, elementNum); }
+        const_iterator end() const { return const_iterator(elementData + elementNum); }
 
-        const_iterator cend() const { return const_iterator(this, elementNum); }
+        const_iterator cend() const { return const_iterator(elementData + elementNum); }
+
+
+        // 连续存储的首元素指针, 空 vector 可能返回 nullptr
+        T *data() { return elementData; }
+
+        const T *data() const { return elementData; }
+
+        std::span<T> span() { return std::span<T>(elementData, elementNum); }
+
+        std::span<const T> span() const { return std::span<const T>(elementData, elementNum); }
 
 
         bool empty() const { return (elementNum == 0); }
 
         size_t size() const { return elementNum; }
 
+        size_t capacity() const { return memorySize; }
+
+        std::pmr::memory_resource *resource() const { return memResource; }
+
+        // 清空元素但保留容量, 需要归还内存时配合 shrink_to_fit 使用
         void clear() {
-            delMem();
+            destroyRange(elementData, elementData + elementNum);
             elementNum = 0;
-            memorySize = VECTOR_INITIAL_SIZE;
-            initMem();
         }
 
+        void reserve(const size_t &newCapacity) {
+            if (newCapacity > memorySize) reallocMem(newCapacity);
+        }
+
+        void shrink_to_fit() {
+            if (elementNum < memorySize) reallocMem(elementNum);
+        }
+
+        void resize(const size_t &newSize) { resizeImpl(newSize); }
+
+        void resize(const size_t &newSize, const T &value) { resizeImpl(newSize, value); }
+
+
+        iterator insert(iterator pos, const T &value) { return emplace(indexOf(pos), value); }
+
+        iterator insert(iterator pos, T &&value) { return emplace(indexOf(pos), std::move(value)); }
 
-        iterator insert(iterator pos, const T &value) { return insert(pos.index, value); }
+        iterator insert(const size_t &id, const T &value) { return emplace(id, value); }
 
-        iterator insert(const size_t &id, const T &value) {
+        iterator insert(const size_t &id, T &&value) { return emplace(id, std::move(value)); }
+
+        template<typename... Args>
+        iterator emplace(iterator pos, Args &&... args) { return emplace(indexOf(pos), std::forward<Args>(args)...); }
+
+        template<typename... Args>
+        iterator emplace(const size_t &id, Args &&... args) {
             if (id > elementNum)throw index_out_of_bound();
             //"Try to Insert Element Out of Range of Vector"
-            if (elementNum == memorySize) {
-                T **originalData = data;
-                memorySize <<= 1;
-                initMem();
-                memcpy(data, originalData, sizePtr * elementNum);
-                delete[] originalData;
+            if (elementNum == memorySize) reallocInsert(nextMemSize(), id, std::forward<Args>(args)...);
+            else if (id == elementNum) new(elementData + elementNum) T(std::forward<Args>(args)...);
+            else {
+                T tempValue(std::forward<Args>(args)...); // args 可能引用本 vector 中的元素
+                if constexpr (trivialElement) bytesMove(elementData + id + 1, elementData + id, elementNum - id);
+                else {
+                    new(elementData + elementNum) T(std::move(elementData[elementNum - 1]));
+                    for (size_t i = elementNum - 1; i > id; --i)elementData[i] = std::move(elementData[i - 1]);
+                }
+                elementData[id] = std::move(tempValue);
             }
-            for (size_t i = elementNum; i > id; --i)data[i] = data[i - 1];
-            data[id] = new T(value);
             ++elementNum;
-            return iterator(this, id);
+            return iterator(elementData + id);
         }
 
-        iterator erase(iterator pos) { return erase(pos.index); }
+        iterator insert(iterator pos, const size_t &n, const T &value) { return insert(indexOf(pos), n, value); }
+
+        iterator insert(const size_t &id, const size_t &n, const T &value) {
+            if (id > elementNum)throw index_out_of_bound();
+            T tempValue(value); // value 可能为本 vector 中的元素
+            insertN(id, n, [&tempValue](T *dest, bool constructed) {
+                if (constructed) *dest = tempValue;
+                else new(dest) T(tempValue);
+            });
+            return iterator(elementData + id);
+        }
+
+        /**
+         * 将 [first, last) 插入至 pos 之前, 尾部元素只搬移一次
+         * first, last 不应为本 vector 的迭代器
+         */
+        template<typename InputIt>
+        requires (!std::is_integral_v<InputIt>)
+        iterator insert(iterator pos, InputIt first, InputIt last) { return insert(indexOf(pos), first, last); }
+
+        template<typename InputIt>
+        requires (!std::is_integral_v<InputIt>)
+        iterator insert(const size_t &id, InputIt first, InputIt last) {
+            if (id > elementNum)throw index_out_of_bound();
+            if constexpr (isSinglePass<InputIt>()) {
+                if (id == elementNum) {
+                    for (; first != last; ++first) emplace_back(*first);
+                } else {
+                    vector tempVec(memResource);
+                    for (; first != last; ++first) tempVec.emplace_back(*first);
+                    T *src = tempVec.elementData;
+                    insertN(id, tempVec.elementNum, [&src](T *dest, bool constructed) {
+                        if (constructed) *dest = std::move(*src);
+                        else new(dest) T(std::move(*src));
+                        ++src;
+                    });
+                }
+            } else {
+                insertN(id, rangeDistance(first, last), [&first](T *dest, bool constructed) {
+                    if (constructed) *dest = *first;
+                    else new(dest) T(*first);
+                    ++first;
+                });
+            }
+            return iterator(elementData + id);
+        }
+
+        // 追加任意提供 begin()/end() 的区间 (包括 sjtu 容器与原生数组)
+        template<typename Range>
+        void append(Range &&range) { insert(elementNum, std::begin(range), std::end(range)); }
+
+        void assign(const size_t &n, const T &value) {
+            T tempValue(value);
+            clear();
+            if (n > memorySize) reallocMem(n);
+            insertN(0, n, [&tempValue](T *dest, bool) { new(dest) T(tempValue); });
+        }
+
+        template<typename InputIt>
+        requires (!std::is_integral_v<InputIt>)
+        void assign(InputIt first, InputIt last) {
+            clear();
+            if constexpr (!isSinglePass<InputIt>()) {
+                size_t n = rangeDistance(first, last);
+                if (n > memorySize) reallocMem(n);
+            }
+            insert(size_t(0), first, last);
+        }
+
+        iterator erase(iterator pos) { return erase(indexOf(pos)); }
 
         iterator erase(const size_t &id) {
             if (id >= elementNum)throw index_out_of_bound();
             //"Try to Erase Element Out of Range of Vector"
-            delete data[id];
             --elementNum;
-            for (size_t i = id; i < elementNum; ++i)data[i] = data[i + 1];
-            data[elementNum] = nullptr;
-            return iterator(this, id);
+            if constexpr (trivialElement) bytesMove(elementData + id, elementData + id + 1, elementNum - id);
+            else for (size_t i = id; i < elementNum; ++i)elementData[i] = std::move(elementData[i + 1]);
+            elementData[elementNum].~T();
+            return iterator(elementData + id);
+        }
+
+        // 删除 [first, last), 尾部元素只搬移一次
+        iterator erase(iterator first, iterator last) { return erase(indexOf(first), indexOf(last)); }
+
+        iterator erase(const size_t &firstId, const size_t &lastId) {
+            if (firstId > lastId || lastId > elementNum)throw index_out_of_bound();
+            size_t n = lastId - firstId;
+            if (n == 0) return iterator(elementData + firstId);
+            if constexpr (trivialElement) bytesMove(elementData + firstId, elementData + lastId, elementNum - lastId);
+            else for (size_t i = lastId; i < elementNum; ++i)elementData[i - n] = std::move(elementData[i]);
+            destroyRange(elementData + elementNum - n, elementData + elementNum);
+            elementNum -= n;
+            return iterator(elementData + firstId);
         }
 
 
-        void push_back(const T &value) {
-            if (elementNum == memorySize) {
-                T **originalData = data;
-                memorySize <<= 1;
-                initMem();
-                memcpy(data, originalData, sizePtr * elementNum);
-                delete[] originalData;
-            }
-            data[elementNum++] = new T(value);
+        void push_back(const T &value) { emplace_back(value); }
+
+        void push_back(T &&value) { emplace_back(std::move(value)); }
+
+        template<typename... Args>
+        T &emplace_back(Args &&... args) {
+            if (elementNum == memorySize) reallocInsert(nextMemSize(), elementNum, std::forward<Args>(args)...);
+            else new(elementData + elementNum) T(std::forward<Args>(args)...);
+            return elementData[elementNum++];
         }
 
 
         void pop_back() {
             if (elementNum == 0)throw container_is_empty();
                 //"Try to Pop Back Element from Empty Vector"
-            else {
-                delete data[--elementNum];
-                data[elementNum] = nullptr;
-            }
+            else elementData[--elementNum].~T();
         }
     };
 
@@ -0,0 +1,490 @@
+#ifndef SJTU_WORK_STEALING_HPP
+#define SJTU_WORK_STEALING_HPP
+
+#include "deque.hpp"
+#include "vector.hpp"
+#include "concurrent_queue.hpp" // PTL_CACHE_LINE_SIZE
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory_resource>
+#include <mutex>
+#include <new> // placement new
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 工作窃取 (work stealing) 的任务调度
+ *   ws_deque: Chase-Lev 双端队列, 所有者线程在末端 push_back / pop_back, 其他线程 (窃取者) 从前端 steal
+ *     底层为可增长的环形数组, 元素须可平凡复制 (通常为任务指针)
+ *   parallel::work_stealing_pool: 每个线程持有一个 ws_deque, 新任务压入本线程的队列 (后进先出, 局部性好),
+ *     本线程的队列为空时随机选择其他线程窃取最早压入的任务 (通常是最大的子问题)
+ *   parallel::task_group: fork / join 接口, spawn 派生任务, wait 在等待期间参与执行任务
+ * 线程池的全部内存 (各线程的队列与任务结点) 由构造时传入的内存资源分配, 该资源须可被多个线程同时使用;
+ *   任务结点按大小分级缓存在执行它的线程的空闲链表中, 派生任务时通常不必访问内存资源
+ */
+#define WS_DEQUE_INITIAL_CAPACITY 64
+#define WS_SPIN_ROUNDS 64 // 工作线程连续找不到任务这么多次后才休眠
+#define WS_TASK_SIZE_CLASSES 4 // 任务结点按 PTL_CACHE_LINE_SIZE 的倍数分级缓存, 更大的结点直接向内存资源申请
+#define WS_TASK_CACHE_LIMIT 1024 // 每个线程每一级至多缓存的结点数
+
+namespace sjtu {
+
+    template<class T>
+    class ws_deque {
+        static_assert(std::is_trivially_copyable_v<T>, "ws_deque only stores trivially copyable elements");
+
+    private:
+        struct RingArray {
+            size_t memorySize, mask;
+            std::atomic<T> *cellData;
+            RingArray *nextRetired;
+
+            std::atomic<T> &at(std::ptrdiff_t index) { return cellData[size_t(index) & mask]; }
+        };
+
+        std::pmr::memory_resource *memResource;
+        alignas(PTL_CACHE_LINE_SIZE) std::atomic<std::ptrdiff_t> topIndex;    // 窃取者通过 CAS 前移
+        alignas(PTL_CACHE_LINE_SIZE) std::atomic<std::ptrdiff_t> bottomIndex; // 仅所有者写
+        std::atomic<RingArray *> ringArray;
+        // 扩容后窃取者可能仍在读旧数组, 因此旧数组串成链表, 析构时统一释放
+        RingArray *retiredArrays;
+
+        RingArray *createArray(size_t size) {
+            auto *array = static_cast<RingArray *>(memResource->allocate(sizeof(RingArray), alignof(RingArray)));
+            array->memorySize = size;
+            array->mask = size - 1;
+            array->nextRetired = nullptr;
+            array->cellData = static_cast<std::atomic<T> *>(
+                    memResource->allocate(sizeof(std::atomic<T>) * size, alignof(std::atomic<T>)));
+            for (size_t i = 0; i < size; ++i) ::new(static_cast<void *>(array->cellData + i)) std::atomic<T>();
+            return array;
+        }
+
+        void destroyArray(RingArray *array) {
+            memResource->deallocate(array->cellData, sizeof(std::atomic<T>) * array->memorySize,
+                                    alignof(std::atomic<T>));
+            memResource->deallocate(array, sizeof(RingArray), alignof(RingArray));
+        }
+
+        RingArray *grow(RingArray *oldArray, std::ptrdiff_t top, std::ptrdiff_t bottom) {
+            RingArray *newArray = createArray(oldArray->memorySize * 2);
+            for (std::ptrdiff_t i = top; i < bottom; ++i)
+                newArray->at(i).store(oldArray->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+            oldArray->nextRetired = retiredArrays;
+            retiredArrays = oldArray;
+            ringArray.store(newArray, std::memory_order_release);
+            return newArray;
+        }
+
+    public:
+        explicit ws_deque(size_t capacity = WS_DEQUE_INITIAL_CAPACITY,
+                          std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                : memResource(res), topIndex(0), bottomIndex(0), retiredArrays(nullptr) {
+            ringArray.store(createArray(concurrent_detail::roundCapacity(capacity)), std::memory_order_relaxed);
+        }
+
+        ws_deque(const ws_deque &other) = delete;
+
+        ws_deque &operator=(const ws_deque &other) = delete;
+
+        ~ws_deque() {
+            destroyArray(ringArray.load(std::memory_order_relaxed));
+            while (retiredArrays != nullptr) {
+                RingArray *nxt = retiredArrays->nextRetired;
+                destroyArray(retiredArrays);
+                retiredArrays = nxt;
+            }
+        }
+
+        // 仅所有者调用, 数组满时容量翻倍
+        void push_back(const T &value) {
+            std::ptrdiff_t bottom = bottomIndex.load(std::memory_order_relaxed);
+            std::ptrdiff_t top = topIndex.load(std::memory_order_acquire);
+            RingArray *array = ringArray.load(std::memory_order_relaxed);
+            if (bottom - top >= std::ptrdiff_t(array->memorySize)) array = grow(array, top, bottom);
+            array->at(bottom).store(value, std::memory_order_relaxed);
+            bottomIndex.store(bottom + 1, std::memory_order_release);
+        }
+
+        // 仅所有者调用, 取出最后压入的元素; 只剩一个元素时与窃取者通过 CAS 竞争
+        bool pop_back(T &out) {
+            std::ptrdiff_t bottom = bottomIndex.load(std::memory_order_relaxed) - 1;
+            RingArray *array = ringArray.load(std::memory_order_relaxed);
+            bottomIndex.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::ptrdiff_t top = topIndex.load(std::memory_order_relaxed);
+            if (top > bottom) {
+                bottomIndex.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+            out = array->at(bottom).load(std::memory_order_relaxed);
+            if (top < bottom) return true;
+            bool won = topIndex.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                        std::memory_order_relaxed);
+            bottomIndex.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        // 任意线程调用, 取出最早压入的元素; 队列为空或与其他线程竞争失败时返回 false
+        bool steal(T &out) {
+            std::ptrdiff_t top = topIndex.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::ptrdiff_t bottom = bottomIndex.load(std::memory_order_acquire);
+            if (top >= bottom) return false;
+            RingArray *array = ringArray.load(std::memory_order_acquire);
+            T value = array->at(top).load(std::memory_order_relaxed);
+            if (!topIndex.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed))
+                return false;
+            out = value;
+            return true;
+        }
+
+        // 有并发修改时只是一个近似值
+        size_t size() const {
+            std::ptrdiff_t bottom = bottomIndex.load(std::memory_order_acquire);
+            std::ptrdiff_t top = topIndex.load(std::memory_order_acquire);
+            return (bottom > top) ? size_t(bottom - top) : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return ringArray.load(std::memory_order_acquire)->memorySize; }
+    };
+
+    namespace parallel {
+
+        class work_stealing_pool;
+
+        namespace ws_detail {
+            struct Task {
+                void (*invoke)(Task *);
+            };
+        }
+
+        /**
+         * 一组 fork / join 任务, 生命周期内须属于同一个 work_stealing_pool
+         * wait() 返回前当前组内派生的全部任务 (包括任务中再次 spawn 到本组的任务) 都已完成,
+         *   任一任务抛出的异常在此时重新抛出
+         * 析构时同样等待全部任务完成, 但不抛出异常
+         */
+        class task_group {
+        private:
+            template<typename Func>
+            struct TaskNode : ws_detail::Task {
+                task_group *group;
+                Func func;
+
+                TaskNode(task_group *g, Func &&f) : ws_detail::Task{&execute}, group(g), func(std::move(f)) {}
+
+                static void execute(ws_detail::Task *base) {
+                    auto *node = static_cast<TaskNode *>(base);
+                    task_group *g = node->group;
+                    try {
+                        node->func();
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(g->errorMutex);
+                        if (!g->error) g->error = std::current_exception();
+                    }
+                    node->~TaskNode();
+                    g->finishTask(node, sizeof(TaskNode), alignof(TaskNode));
+                }
+            };
+
+            work_stealing_pool &pool;
+            std::atomic<size_t> pendingNum;
+            std::mutex errorMutex;
+            std::exception_ptr error;
+
+            void join();
+
+            // 归还已析构的任务结点, 之后本组可能随时被销毁
+            void finishTask(void *node, size_t bytes, size_t alignment);
+
+        public:
+            explicit task_group(work_stealing_pool &p) : pool(p), pendingNum(0) {}
+
+            task_group(const task_group &other) = delete;
+
+            task_group &operator=(const task_group &other) = delete;
+
+            ~task_group() { join(); }
+
+            template<typename Func>
+            void spawn(Func &&func);
+
+            void wait();
+        };
+
+        class work_stealing_pool {
+            friend class task_group;
+
+        private:
+            struct FreeTask {
+                FreeTask *nxtTask;
+            };
+
+            // 空闲链表只由所属线程访问
+            struct alignas(PTL_CACHE_LINE_SIZE) Worker {
+                ws_deque<ws_detail::Task *> tasks;
+                FreeTask *freeTasks[WS_TASK_SIZE_CLASSES] = {};
+                size_t freeTaskNum[WS_TASK_SIZE_CLASSES] = {};
+
+                explicit Worker(std::pmr::memory_resource *res) : tasks(WS_DEQUE_INITIAL_CAPACITY, res) {}
+            };
+
+            struct ThreadContext {
+                work_stealing_pool *pool;
+                size_t workerId;
+                size_t randomState;
+            };
+
+            static constexpr size_t npos = size_t(-1);
+
+            std::pmr::memory_resource *memResource;
+            size_t workerNum;
+            Worker *workers;
+            sjtu::vector<std::thread> threads;
+            std::thread::id ownerThread; // 构造线程使用 0 号队列
+
+            // 其他外部线程派生的任务
+            sjtu::deque<ws_detail::Task *> injectedTasks;
+            std::mutex injectMutex;
+            std::atomic<size_t> injectedNum;
+
+            std::mutex sleepMutex;
+            std::condition_variable sleepCond;
+            std::atomic<size_t> sleeperNum;
+            size_t wakeEpoch; // 由 sleepMutex 保护
+            bool stopping;    // 由 sleepMutex 保护
+            std::atomic<bool> stopFlag;
+
+            static ThreadContext &context() {
+                static thread_local ThreadContext ctx{nullptr, 0, 0};
+                return ctx;
+            }
+
+            size_t currentWorker() const {
+                ThreadContext &ctx = context();
+                if (ctx.pool == this) return ctx.workerId;
+                return (std::this_thread::get_id() == ownerThread) ? 0 : npos;
+            }
+
+            static size_t nextRandom() {
+                size_t &x = context().randomState;
+                if (x == 0) x = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                return x;
+            }
+
+            void submit(ws_detail::Task *task) {
+                size_t id = currentWorker();
+                if (id != npos) {
+                    workers[id].tasks.push_back(task);
+                } else {
+                    std::lock_guard<std::mutex> lock(injectMutex);
+                    injectedTasks.push_back(task);
+                    injectedNum.fetch_add(1, std::memory_order_relaxed);
+                }
+                // 与 sleep() 中的 sleeperNum 自增构成 Dekker 式同步: 要么这里看到休眠者, 要么休眠者看到新任务
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (sleeperNum.load(std::memory_order_relaxed) > 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(sleepMutex);
+                        ++wakeEpoch;
+                    }
+                    sleepCond.notify_one();
+                }
+            }
+
+            ws_detail::Task *findTask(size_t id) {
+                ws_detail::Task *task;
+                if (id != npos && workers[id].tasks.pop_back(task)) return task;
+                if (injectedNum.load(std::memory_order_relaxed) > 0) {
+                    std::lock_guard<std::mutex> lock(injectMutex);
+                    if (!injectedTasks.empty()) {
+                        task = injectedTasks.front();
+                        injectedTasks.pop_front();
+                        injectedNum.fetch_sub(1, std::memory_order_relaxed);
+                        return task;
+                    }
+                }
+                // 从随机位置开始依次尝试窃取, 避免所有空闲线程同时争抢同一个队列
+                size_t start = nextRandom() % workerNum;
+                for (size_t i = 0; i < workerNum; ++i) {
+                    size_t victim = (start + i) % workerNum;
+                    if (victim != id && workers[victim].tasks.steal(task)) return task;
+                }
+                return nullptr;
+            }
+
+            // 可缓存的结点所属的级别, 不可缓存时返回 WS_TASK_SIZE_CLASSES
+            static size_t taskClass(size_t bytes, size_t alignment) {
+                if (alignment > PTL_CACHE_LINE_SIZE) return WS_TASK_SIZE_CLASSES;
+                size_t cls = (bytes - 1) / PTL_CACHE_LINE_SIZE;
+                return (cls < WS_TASK_SIZE_CLASSES) ? cls : WS_TASK_SIZE_CLASSES;
+            }
+
+            // 可缓存的结点无论由哪个线程申请, 都按所在级别的大小与缓存行对齐向内存资源申请, 因此可在任意线程间流转
+            void *allocateTask(size_t bytes, size_t alignment) {
+                size_t cls = taskClass(bytes, alignment), id = currentWorker();
+                if (cls == WS_TASK_SIZE_CLASSES) return memResource->allocate(bytes, alignment);
+                if (id != npos && workers[id].freeTasks[cls] != nullptr) {
+                    Worker &worker = workers[id];
+                    FreeTask *task = worker.freeTasks[cls];
+                    worker.freeTasks[cls] = task->nxtTask;
+                    --worker.freeTaskNum[cls];
+                    return task;
+                }
+                return memResource->allocate((cls + 1) * PTL_CACHE_LINE_SIZE, PTL_CACHE_LINE_SIZE);
+            }
+
+            void releaseTask(void *p, size_t bytes, size_t alignment) {
+                size_t cls = taskClass(bytes, alignment), id = currentWorker();
+                if (cls == WS_TASK_SIZE_CLASSES) {
+                    memResource->deallocate(p, bytes, alignment);
+                } else if (id != npos && workers[id].freeTaskNum[cls] < WS_TASK_CACHE_LIMIT) {
+                    Worker &worker = workers[id];
+                    worker.freeTasks[cls] = ::new(p) FreeTask{worker.freeTasks[cls]};
+                    ++worker.freeTaskNum[cls];
+                } else {
+                    memResource->deallocate(p, (cls + 1) * PTL_CACHE_LINE_SIZE, PTL_CACHE_LINE_SIZE);
+                }
+            }
+
+            bool hasVisibleTask() const {
+                if (injectedNum.load(std::memory_order_relaxed) > 0) return true;
+                for (size_t i = 0; i < workerNum; ++i)
+                    if (!workers[i].tasks.empty()) return true;
+                return false;
+            }
+
+            void sleep() {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                size_t epoch = wakeEpoch;
+                sleeperNum.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!hasVisibleTask()) sleepCond.wait(lock, [&] { return stopping || wakeEpoch != epoch; });
+                sleeperNum.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            void workerLoop(size_t id) {
+                context().pool = this;
+                context().workerId = id;
+                size_t idleRounds = 0;
+                while (!stopFlag.load(std::memory_order_acquire)) {
+                    if (ws_detail::Task *task = findTask(id)) {
+                        task->invoke(task);
+                        idleRounds = 0;
+                    } else if (++idleRounds < WS_SPIN_ROUNDS) {
+                        std::this_thread::yield();
+                    } else {
+                        idleRounds = 0;
+                        sleep();
+                    }
+                }
+            }
+
+            // 在 pendingNum 归零前持续执行任务 (本线程队列中的, 或窃取来的)
+            void helpUntilDone(const std::atomic<size_t> &pendingNum) {
+                size_t id = currentWorker();
+                while (pendingNum.load(std::memory_order_acquire) != 0) {
+                    if (ws_detail::Task *task = findTask(id)) task->invoke(task);
+                    else std::this_thread::yield();
+                }
+            }
+
+        public:
+            /**
+             * threadNum 包含构造线程本身, 即实际创建 threadNum - 1 个工作线程; 构造线程在 task_group::wait 中参与执行
+             * res 会被各个线程同时调用, 须是线程安全的 (默认资源, 或 std::pmr::synchronized_pool_resource 等)
+             */
+            explicit work_stealing_pool(size_t threadNum = std::thread::hardware_concurrency(),
+                                        std::pmr::memory_resource *res = std::pmr::get_default_resource())
+                    : memResource(res), workerNum(threadNum == 0 ? 1 : threadNum), workers(nullptr), threads(res),
+                      ownerThread(std::this_thread::get_id()), injectedTasks(res), injectedNum(0), sleeperNum(0),
+                      wakeEpoch(0), stopping(false), stopFlag(false) {
+                workers = static_cast<Worker *>(memResource->allocate(sizeof(Worker) * workerNum, alignof(Worker)));
+                for (size_t i = 0; i < workerNum; ++i) ::new(static_cast<void *>(workers + i)) Worker(memResource);
+                for (size_t i = 1; i < workerNum; ++i)
+                    threads.emplace_back([this, i] { workerLoop(i); });
+            }
+
+            work_stealing_pool(const work_stealing_pool &other) = delete;
+
+            work_stealing_pool &operator=(const work_stealing_pool &other) = delete;
+
+            // 析构前所有 task_group 都应已结束
+            ~work_stealing_pool() {
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    stopping = true;
+                    stopFlag.store(true, std::memory_order_release);
+                }
+                sleepCond.notify_all();
+                for (std::thread &thread:threads) thread.join();
+                for (size_t i = 0; i < workerNum; ++i) {
+                    for (size_t cls = 0; cls < WS_TASK_SIZE_CLASSES; ++cls)
+                        while (FreeTask *task = workers[i].freeTasks[cls]) {
+                            workers[i].freeTasks[cls] = task->nxtTask;
+                            memResource->deallocate(task, (cls + 1) * PTL_CACHE_LINE_SIZE, PTL_CACHE_LINE_SIZE);
+                        }
+                    workers[i].~Worker();
+                }
+                memResource->deallocate(workers, sizeof(Worker) * workerNum, alignof(Worker));
+            }
+
+            size_t size() const { return workerNum; }
+
+            std::pmr::memory_resource *resource() const { return memResource; }
+        };
+
+        template<typename Func>
+        void task_group::spawn(Func &&func) {
+            using Node = TaskNode<std::decay_t<Func>>;
+            void *mem = pool.allocateTask(sizeof(Node), alignof(Node));
+            Node *node;
+            try {
+                node = ::new(mem) Node(this, std::decay_t<Func>(std::forward<Func>(func)));
+            } catch (...) {
+                pool.releaseTask(mem, sizeof(Node), alignof(Node));
+                throw;
+            }
+            pendingNum.fetch_add(1, std::memory_order_relaxed);
+            pool.submit(node);
+        }
+
+        inline void task_group::join() { pool.helpUntilDone(pendingNum); }
+
+        inline void task_group::finishTask(void *node, size_t bytes, size_t alignment) {
+            pool.releaseTask(node, bytes, alignment);
+            pendingNum.fetch_sub(1, std::memory_order_release);
+        }
+
+        inline void task_group::wait() {
+            join();
+            std::exception_ptr firstError;
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                firstError = error;
+                error = nullptr;
+            }
+            if (firstError) std::rethrow_exception(firstError);
+        }
+
+        inline work_stealing_pool &default_work_stealing_pool() {
+            static work_stealing_pool pool;
+            return pool;
+        }
+
+    }
+
+}
+
+#endif